@@ -0,0 +1,152 @@
+#include "batch_math.h"
+
+#include <assert.h>
+
+// Batches...
+//
+
+V2Batch PushV2Batch(Arena *arena, u32 capacity)
+{
+    V2Batch batch = {};
+    batch.capacity = BatchPadded(capacity);
+    batch.x = (f32 *) AllocateBytesZero(arena, sizeof(f32) * batch.capacity, 32);
+    batch.y = (f32 *) AllocateBytesZero(arena, sizeof(f32) * batch.capacity, 32);
+    return batch;
+}
+
+V2Batch V2BatchFromArrays(f32 *x, f32 *y, u32 count, u32 capacity)
+{
+    assert(((u64) x & 31) == 0 && ((u64) y & 31) == 0);
+    assert(capacity == BatchPadded(capacity) && count <= capacity);
+
+    V2Batch batch = {};
+    batch.count = count;
+    batch.capacity = capacity;
+    batch.x = x;
+    batch.y = y;
+    return batch;
+}
+
+void BatchAdd(V2Batch *out, V2Batch *a, V2Batch *b)
+{
+    u32 count = BatchPadded(a->count);
+    assert(b->count == a->count && out->capacity >= count);
+
+    for (u32 i = 0; i < count; i += LANE_WIDTH)
+    {
+        LaneStore(out->x + i, LaneAdd(LaneLoad(a->x + i), LaneLoad(b->x + i)));
+        LaneStore(out->y + i, LaneAdd(LaneLoad(a->y + i), LaneLoad(b->y + i)));
+    }
+    out->count = a->count;
+}
+
+void BatchScale(V2Batch *a, f32 t)
+{
+    u32 count = BatchPadded(a->count);
+    Lane scale = LaneSet(t);
+
+    for (u32 i = 0; i < count; i += LANE_WIDTH)
+    {
+        LaneStore(a->x + i, LaneMul(LaneLoad(a->x + i), scale));
+        LaneStore(a->y + i, LaneMul(LaneLoad(a->y + i), scale));
+    }
+}
+
+void BatchAddScaled(V2Batch *a, V2Batch *b, f32 t)
+{
+    u32 count = BatchPadded(a->count);
+    assert(b->count >= a->count);
+    Lane scale = LaneSet(t);
+
+    for (u32 i = 0; i < count; i += LANE_WIDTH)
+    {
+        LaneStore(a->x + i, LaneAdd(LaneLoad(a->x + i), LaneMul(LaneLoad(b->x + i), scale)));
+        LaneStore(a->y + i, LaneAdd(LaneLoad(a->y + i), LaneMul(LaneLoad(b->y + i), scale)));
+    }
+}
+
+void BatchNormalize(V2Batch *a)
+{
+    u32 count = BatchPadded(a->count);
+
+#if LANE_WIDTH > 1
+    Lane threshold = LaneSet(0.001);
+    Lane one = LaneSet(1);
+
+    for (u32 i = 0; i < count; i += LANE_WIDTH)
+    {
+        Lane x = LaneLoad(a->x + i);
+        Lane y = LaneLoad(a->y + i);
+        Lane square_length = LaneAdd(LaneMul(x, x), LaneMul(y, y));
+        Lane valid = LaneGreaterEqual(square_length, threshold);
+        Lane inv_length = LaneAnd(LaneDiv(one, LaneSqrt(square_length)), valid);
+        LaneStore(a->x + i, LaneMul(x, inv_length));
+        LaneStore(a->y + i, LaneMul(y, inv_length));
+    }
+#else
+    for (u32 i = 0; i < count; ++i)
+    {
+        SetV2(a, i, Norm(GetV2(a, i)));
+    }
+#endif
+}
+
+void BatchIntegrate(V2Batch *position, V2Batch *velocity, V2Batch *acceleration, f32 delta)
+{
+    u32 count = BatchPadded(position->count);
+    assert(velocity->count >= position->count);
+    Lane dt = LaneSet(delta);
+
+    for (u32 i = 0; i < count; i += LANE_WIDTH)
+    {
+        Lane vx = LaneLoad(velocity->x + i);
+        Lane vy = LaneLoad(velocity->y + i);
+
+        if (acceleration)
+        {
+            vx = LaneAdd(vx, LaneMul(LaneLoad(acceleration->x + i), dt));
+            vy = LaneAdd(vy, LaneMul(LaneLoad(acceleration->y + i), dt));
+            LaneStore(velocity->x + i, vx);
+            LaneStore(velocity->y + i, vy);
+        }
+
+        LaneStore(position->x + i, LaneAdd(LaneLoad(position->x + i), LaneMul(vx, dt)));
+        LaneStore(position->y + i, LaneAdd(LaneLoad(position->y + i), LaneMul(vy, dt)));
+    }
+}
+
+u32 BatchAABBCollision(V2 bl, V2 tr, V2Batch *positions, V2 half_size, u32 *hits)
+{
+    u32 hit_count = 0;
+
+#if LANE_WIDTH > 1
+    u32 count = BatchPadded(positions->count);
+
+    // Grow the query box by the half size instead of building a box per position
+    Lane min_x = LaneSet(bl.x - half_size.x);
+    Lane min_y = LaneSet(bl.y - half_size.y);
+    Lane max_x = LaneSet(tr.x + half_size.x);
+    Lane max_y = LaneSet(tr.y + half_size.y);
+
+    for (u32 i = 0; i < count; i += LANE_WIDTH)
+    {
+        Lane x = LaneLoad(positions->x + i);
+        Lane y = LaneLoad(positions->y + i);
+        Lane inside = LaneAnd(LaneAnd(LaneGreaterEqual(x, min_x), LaneLessEqual(x, max_x)),
+                              LaneAnd(LaneGreaterEqual(y, min_y), LaneLessEqual(y, max_y)));
+
+        hit_count = AppendLaneIndices(LaneMask(inside), i, positions->count, hits, hit_count);
+    }
+#else
+    for (u32 i = 0; i < positions->count; ++i)
+    {
+        V2 p = GetV2(positions, i);
+        if (AABBCollision(bl, tr, p - half_size, p + half_size))
+        {
+            hits[hit_count++] = i;
+        }
+    }
+#endif
+
+    return hit_count;
+}
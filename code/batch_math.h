@@ -0,0 +1,47 @@
+#pragma once
+
+#include "defines.h"
+#include "game_math.h"
+#include "memory.h"
+#include "simd.h"
+
+// Structure of arrays V2s. The arrays are 32 byte aligned and padded to a
+// multiple of BATCH_WIDTH, so the kernels run 8 wide (AVX) / 4 wide (SSE)
+// over the whole batch without a scalar tail. Padding lanes hold garbage.
+
+struct V2Batch
+{
+    u32 count;
+    u32 capacity;
+    f32 *x;
+    f32 *y;
+};
+
+inline V2 GetV2(V2Batch *batch, u32 index)
+{
+    return v2(batch->x[index], batch->y[index]);
+}
+
+inline void SetV2(V2Batch *batch, u32 index, V2 value)
+{
+    batch->x[index] = value.x;
+    batch->y[index] = value.y;
+}
+
+V2Batch PushV2Batch(Arena *arena, u32 capacity);
+V2Batch V2BatchFromArrays(f32 *x, f32 *y, u32 count, u32 capacity);
+
+// out = a + b
+void BatchAdd(V2Batch *out, V2Batch *a, V2Batch *b);
+// a *= t
+void BatchScale(V2Batch *a, f32 t);
+// a += b * t
+void BatchAddScaled(V2Batch *a, V2Batch *b, f32 t);
+// Same semantics as Norm(V2): near zero vectors become zero
+void BatchNormalize(V2Batch *a);
+// velocity += acceleration * delta; position += velocity * delta. acceleration may be NULL.
+void BatchIntegrate(V2Batch *position, V2Batch *velocity, V2Batch *acceleration, f32 delta);
+
+// Tests the box (bl, tr) against boxes of half_size centered on every position, like
+// AABBCollision. Writes the indices of the hits to `hits` and returns how many there are.
+u32 BatchAABBCollision(V2 bl, V2 tr, V2Batch *positions, V2 half_size, u32 *hits);
@@ -37,12 +37,7 @@ void UpdateCamera(Camera *camera)
 
     V3 right = Norm(Cross(camera->front, v3(0, 1, 0)));
 
-    camera->pos.x += camera->front.x * movement.x * delta * speed;
-    camera->pos.y += camera->front.y * movement.x * delta * speed;
-    camera->pos.z += camera->front.z * movement.x * delta * speed;
-    camera->pos.x += right.x * movement.y * delta * speed;
-    camera->pos.y += right.y * movement.y * delta * speed;
-    camera->pos.z += right.z * movement.y * delta * speed;
+    camera->pos += (camera->front * movement.x + right * movement.y) * (delta * speed);
 };
 
 void UpdateCameraMouse(Camera *camera)
@@ -0,0 +1,158 @@
+#include "culling.h"
+
+#include <assert.h>
+
+Frustum ExtractFrustum(Mat4 m)
+{
+    Frustum frustum = {};
+
+    V4 row0 = v4(m.v[0], m.v[4], m.v[8], m.v[12]);
+    V4 row1 = v4(m.v[1], m.v[5], m.v[9], m.v[13]);
+    V4 row2 = v4(m.v[2], m.v[6], m.v[10], m.v[14]);
+    V4 row3 = v4(m.v[3], m.v[7], m.v[11], m.v[15]);
+
+    frustum.planes[0] = row3 + row0;
+    frustum.planes[1] = row3 - row0;
+    frustum.planes[2] = row3 + row1;
+    frustum.planes[3] = row3 - row1;
+    frustum.planes[4] = row3 + row2;
+    frustum.planes[5] = row3 - row2;
+
+    for (u32 i = 0; i < 6; ++i)
+    {
+        V4 plane = frustum.planes[i];
+        f32 length = Length(v3(plane.x, plane.y, plane.z));
+        frustum.planes[i] = plane / length;
+    }
+
+    return frustum;
+}
+
+inline f32 *PushBoundsArray(Arena *arena, u32 capacity)
+{
+    return (f32 *) AllocateBytesZero(arena, sizeof(f32) * capacity, 32);
+}
+
+SphereBounds PushSphereBounds(Arena *arena, u32 capacity)
+{
+    SphereBounds bounds = {};
+    bounds.capacity = BatchPadded(capacity);
+    bounds.x = PushBoundsArray(arena, bounds.capacity);
+    bounds.y = PushBoundsArray(arena, bounds.capacity);
+    bounds.z = PushBoundsArray(arena, bounds.capacity);
+    bounds.radius = PushBoundsArray(arena, bounds.capacity);
+    return bounds;
+}
+
+BoxBounds PushBoxBounds(Arena *arena, u32 capacity)
+{
+    BoxBounds bounds = {};
+    bounds.capacity = BatchPadded(capacity);
+    bounds.min_x = PushBoundsArray(arena, bounds.capacity);
+    bounds.min_y = PushBoundsArray(arena, bounds.capacity);
+    bounds.min_z = PushBoundsArray(arena, bounds.capacity);
+    bounds.max_x = PushBoundsArray(arena, bounds.capacity);
+    bounds.max_y = PushBoundsArray(arena, bounds.capacity);
+    bounds.max_z = PushBoundsArray(arena, bounds.capacity);
+    return bounds;
+}
+
+u32 CullSpheres(Frustum *frustum, SphereBounds *bounds, u32 *visible)
+{
+    assert(bounds->count <= bounds->capacity);
+    u32 visible_count = 0;
+
+#if LANE_WIDTH > 1
+    u32 count = BatchPadded(bounds->count);
+
+    for (u32 i = 0; i < count; i += LANE_WIDTH)
+    {
+        Lane x = LaneLoad(bounds->x + i);
+        Lane y = LaneLoad(bounds->y + i);
+        Lane z = LaneLoad(bounds->z + i);
+        Lane neg_radius = LaneSub(LaneSet(0), LaneLoad(bounds->radius + i));
+        Lane inside = LaneTrue();
+
+        for (u32 p = 0; p < 6; ++p)
+        {
+            V4 plane = frustum->planes[p];
+            Lane distance = MulAdd(LaneSet(plane.x), x,
+                            MulAdd(LaneSet(plane.y), y,
+                            MulAdd(LaneSet(plane.z), z, LaneSet(plane.w))));
+            inside = LaneAnd(inside, LaneGreaterEqual(distance, neg_radius));
+        }
+
+        visible_count = AppendLaneIndices(LaneMask(inside), i, bounds->count, visible, visible_count);
+    }
+#else
+    for (u32 i = 0; i < bounds->count; ++i)
+    {
+        V4 center = v4(bounds->x[i], bounds->y[i], bounds->z[i], 1);
+        bool inside = true;
+        for (u32 p = 0; p < 6; ++p)
+        {
+            inside = inside && Dot(frustum->planes[p], center) >= -bounds->radius[i];
+        }
+
+        if (inside)
+        {
+            visible[visible_count++] = i;
+        }
+    }
+#endif
+
+    return visible_count;
+}
+
+u32 CullBoxes(Frustum *frustum, BoxBounds *bounds, u32 *visible)
+{
+    assert(bounds->count <= bounds->capacity);
+    u32 visible_count = 0;
+
+#if LANE_WIDTH > 1
+    u32 count = BatchPadded(bounds->count);
+
+    for (u32 i = 0; i < count; i += LANE_WIDTH)
+    {
+        Lane inside = LaneTrue();
+
+        for (u32 p = 0; p < 6; ++p)
+        {
+            // Test the corner furthest along the plane normal. The normal is the same
+            // for every lane, so picking the corner is a scalar branch, not a blend.
+            V4 plane = frustum->planes[p];
+            Lane x = LaneLoad((plane.x >= 0 ? bounds->max_x : bounds->min_x) + i);
+            Lane y = LaneLoad((plane.y >= 0 ? bounds->max_y : bounds->min_y) + i);
+            Lane z = LaneLoad((plane.z >= 0 ? bounds->max_z : bounds->min_z) + i);
+
+            Lane distance = MulAdd(LaneSet(plane.x), x,
+                            MulAdd(LaneSet(plane.y), y,
+                            MulAdd(LaneSet(plane.z), z, LaneSet(plane.w))));
+            inside = LaneAnd(inside, LaneGreaterEqual(distance, LaneSet(0)));
+        }
+
+        visible_count = AppendLaneIndices(LaneMask(inside), i, bounds->count, visible, visible_count);
+    }
+#else
+    for (u32 i = 0; i < bounds->count; ++i)
+    {
+        bool inside = true;
+        for (u32 p = 0; p < 6; ++p)
+        {
+            V4 plane = frustum->planes[p];
+            V4 corner = v4(plane.x >= 0 ? bounds->max_x[i] : bounds->min_x[i],
+                           plane.y >= 0 ? bounds->max_y[i] : bounds->min_y[i],
+                           plane.z >= 0 ? bounds->max_z[i] : bounds->min_z[i],
+                           1);
+            inside = inside && Dot(plane, corner) >= 0;
+        }
+
+        if (inside)
+        {
+            visible[visible_count++] = i;
+        }
+    }
+#endif
+
+    return visible_count;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "defines.h"
+#include "game_math.h"
+#include "memory.h"
+#include "simd.h"
+
+// View frustum culling. Bounds are stored as padded structure of arrays so the
+// plane tests run LANE_WIDTH bounds at a time.
+
+struct Frustum
+{
+    // xyz is the inward facing unit normal, w the distance. Inside when dot(n, p) + w >= 0.
+    // Order: left, right, bottom, top, near, far.
+    V4 planes[6];
+};
+
+struct SphereBounds
+{
+    u32 count;
+    u32 capacity;
+    f32 *x;
+    f32 *y;
+    f32 *z;
+    f32 *radius;
+};
+
+struct BoxBounds
+{
+    u32 count;
+    u32 capacity;
+    f32 *min_x;
+    f32 *min_y;
+    f32 *min_z;
+    f32 *max_x;
+    f32 *max_y;
+    f32 *max_z;
+};
+
+// Gribb/Hartmann extraction from projection * view
+Frustum ExtractFrustum(Mat4 view_projection);
+
+SphereBounds PushSphereBounds(Arena *arena, u32 capacity);
+BoxBounds PushBoxBounds(Arena *arena, u32 capacity);
+
+inline void AddSphere(SphereBounds *bounds, V3 center, f32 radius)
+{
+    u32 i = bounds->count++;
+    bounds->x[i] = center.x;
+    bounds->y[i] = center.y;
+    bounds->z[i] = center.z;
+    bounds->radius[i] = radius;
+}
+
+inline void AddBox(BoxBounds *bounds, V3 min, V3 max)
+{
+    u32 i = bounds->count++;
+    bounds->min_x[i] = min.x;
+    bounds->min_y[i] = min.y;
+    bounds->min_z[i] = min.z;
+    bounds->max_x[i] = max.x;
+    bounds->max_y[i] = max.y;
+    bounds->max_z[i] = max.z;
+}
+
+// Write the indices of the bounds that intersect the frustum and return how many
+// there are. Conservative: bounds near a frustum corner may pass.
+u32 CullSpheres(Frustum *frustum, SphereBounds *bounds, u32 *visible);
+u32 CullBoxes(Frustum *frustum, BoxBounds *bounds, u32 *visible);
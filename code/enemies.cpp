@@ -0,0 +1,230 @@
+#include "enemies.h"
+
+#include <assert.h>
+
+void ComputeSeparation(SpatialHash *hash, EnemyParams *params, f32 *push_x, f32 *push_y)
+{
+    assert(params->separation_radius <= hash->cell_size);
+
+    f32 radius = params->separation_radius;
+    f32 inv_radius = 1 / radius;
+
+#if LANE_WIDTH > 1
+    Lane radius_sq = LaneSet(radius * radius);
+    Lane inv_r = LaneSet(inv_radius);
+    Lane one = LaneSet(1);
+    Lane zero = LaneSet(0);
+    Lane lane_step = LaneSet(LANE_WIDTH);
+#endif
+
+    u32 cells[9];
+    u32 cell_count = 0;
+    i32 prev_cell_x = 0;
+    i32 prev_cell_y = 0;
+
+    // Walk the items in grid order, so neighbouring items share their cells in
+    // cache and consecutive items in one cell share the neighbour lookup
+    for (u32 slot = 0; slot < hash->count; ++slot)
+    {
+        f32 px = hash->x[slot];
+        f32 py = hash->y[slot];
+
+        i32 cell_x = CellCoordinate(hash, px);
+        i32 cell_y = CellCoordinate(hash, py);
+        if (!cell_count || cell_x != prev_cell_x || cell_y != prev_cell_y)
+        {
+            cell_count = NeighbourCells(hash, cell_x, cell_y, cells);
+            prev_cell_x = cell_x;
+            prev_cell_y = cell_y;
+        }
+
+        // Push away from every neighbour with weight 1/d - 1/r, which fades to
+        // zero at the radius and grows without bound when they overlap
+#if LANE_WIDTH > 1
+        Lane x = LaneSet(px);
+        Lane y = LaneSet(py);
+        Lane acc_x = zero;
+        Lane acc_y = zero;
+
+        for (u32 c = 0; c < cell_count; ++c)
+        {
+            u32 start = hash->cell_start[cells[c]];
+            u32 end = hash->cell_start[cells[c] + 1];
+            Lane lane_end = LaneSet(end);
+            Lane lane_index = LaneAdd(LaneIndices(), LaneSet(start));
+
+            // Ranges start anywhere, so the loads are unaligned and the lanes past
+            // the end of the range are masked off
+            for (u32 i = start; i < end; i += LANE_WIDTH)
+            {
+                Lane dx = LaneSub(x, LaneLoadUnaligned(hash->x + i));
+                Lane dy = LaneSub(y, LaneLoadUnaligned(hash->y + i));
+                Lane distance_sq = LaneAdd(LaneMul(dx, dx), LaneMul(dy, dy));
+
+                // distance_sq > 0 also skips the item itself
+                Lane near = LaneAnd(LaneAnd(LaneGreater(distance_sq, zero), LaneLess(distance_sq, radius_sq)),
+                                    LaneLess(lane_index, lane_end));
+                Lane weight = LaneSub(LaneDiv(one, LaneSqrt(distance_sq)), inv_r);
+                weight = LaneAnd(weight, near);
+
+                acc_x = MulAdd(dx, weight, acc_x);
+                acc_y = MulAdd(dy, weight, acc_y);
+                lane_index = LaneAdd(lane_index, lane_step);
+            }
+        }
+
+        f32 sum_x = LaneSum(acc_x);
+        f32 sum_y = LaneSum(acc_y);
+#else
+        f32 sum_x = 0;
+        f32 sum_y = 0;
+
+        for (u32 c = 0; c < cell_count; ++c)
+        {
+            u32 end = hash->cell_start[cells[c] + 1];
+            for (u32 i = hash->cell_start[cells[c]]; i < end; ++i)
+            {
+                f32 dx = px - hash->x[i];
+                f32 dy = py - hash->y[i];
+                f32 distance_sq = dx * dx + dy * dy;
+
+                if (distance_sq > 0 && distance_sq < radius * radius)
+                {
+                    f32 weight = 1 / Sqrt(distance_sq) - inv_radius;
+                    sum_x += dx * weight;
+                    sum_y += dy * weight;
+                }
+            }
+        }
+#endif
+
+        u32 id = hash->ids[slot];
+        push_x[id] = sum_x * params->separation_strength;
+        push_y[id] = sum_y * params->separation_strength;
+    }
+}
+
+void RemoveEnemy(Chunk *chunk, u32 index)
+{
+    ChunkData *data = chunk->data;
+    u32 last = --chunk->enemy_count;
+    chunk->flags |= ChunkFlag_Modified;
+
+    data->enemy_x[index] = data->enemy_x[last];
+    data->enemy_y[index] = data->enemy_y[last];
+    data->enemy_vel_x[index] = data->enemy_vel_x[last];
+    data->enemy_vel_y[index] = data->enemy_vel_y[last];
+    data->enemy_hp[index] = data->enemy_hp[last];
+    data->enemy_damage[index] = data->enemy_damage[last];
+    data->enemy_state[index] = data->enemy_state[last];
+
+    u64 hurt = data->enemy_hurt;
+    u64 last_hurt = (hurt >> last) & 1;
+    hurt = (hurt & ~(1ull << index)) | (last_hurt << index);
+    data->enemy_hurt = hurt & ~(1ull << last);
+}
+
+u32 UpdateChunkEnemies(Chunk *chunk, EnemyParams *params, f32 *push_x, f32 *push_y, f32 delta)
+{
+    ChunkData *data = chunk->data;
+    if (!chunk->enemy_count)
+    {
+        return 0;
+    }
+
+    // Positions and hp change every tick, the chunk no longer matches its seed or save
+    chunk->flags |= ChunkFlag_Modified;
+
+    f32 chunk_pixels = CHUNK_SIZE * TILE_SIZE;
+    f32 min_x = chunk->x * chunk_pixels;
+    f32 min_y = chunk->y * chunk_pixels;
+    f32 max_x = min_x + chunk_pixels;
+    f32 max_y = min_y + chunk_pixels;
+    f32 damping = Max(1 - params->drag * delta, 0);
+
+    u64 hurt = 0;
+    u64 dead = 0;
+
+#if LANE_WIDTH > 1
+    u32 count = BatchPadded(chunk->enemy_count);
+    Lane dt = LaneSet(delta);
+    Lane damp = LaneSet(damping);
+    Lane zero = LaneSet(0);
+    Lane lane_min_x = LaneSet(min_x);
+    Lane lane_min_y = LaneSet(min_y);
+    Lane lane_max_x = LaneSet(max_x);
+    Lane lane_max_y = LaneSet(max_y);
+
+    for (u32 i = 0; i < count; i += LANE_WIDTH)
+    {
+        // Movement
+        Lane vx = LaneMul(MulAdd(LaneLoadUnaligned(push_x + i), dt, LaneLoad(data->enemy_vel_x + i)), damp);
+        Lane vy = LaneMul(MulAdd(LaneLoadUnaligned(push_y + i), dt, LaneLoad(data->enemy_vel_y + i)), damp);
+        Lane x = MulAdd(vx, dt, LaneLoad(data->enemy_x + i));
+        Lane y = MulAdd(vy, dt, LaneLoad(data->enemy_y + i));
+
+        // Enemies do not cross chunks yet, they stop at the edge
+        vx = LaneAnd(vx, LaneAnd(LaneGreaterEqual(x, lane_min_x), LaneLessEqual(x, lane_max_x)));
+        vy = LaneAnd(vy, LaneAnd(LaneGreaterEqual(y, lane_min_y), LaneLessEqual(y, lane_max_y)));
+        x = LaneMin(LaneMax(x, lane_min_x), lane_max_x);
+        y = LaneMin(LaneMax(y, lane_min_y), lane_max_y);
+
+        LaneStore(data->enemy_x + i, x);
+        LaneStore(data->enemy_y + i, y);
+        LaneStore(data->enemy_vel_x + i, vx);
+        LaneStore(data->enemy_vel_y + i, vy);
+
+        // Damage
+        Lane damage = LaneLoad(data->enemy_damage + i);
+        Lane hp = LaneSub(LaneLoad(data->enemy_hp + i), damage);
+        LaneStore(data->enemy_hp + i, hp);
+        LaneStore(data->enemy_damage + i, zero);
+
+        hurt |= (u64) LaneMask(LaneGreater(damage, zero)) << i;
+        dead |= (u64) LaneMask(LaneLessEqual(hp, zero)) << i;
+    }
+#else
+    for (u32 i = 0; i < chunk->enemy_count; ++i)
+    {
+        f32 vx = (data->enemy_vel_x[i] + push_x[i] * delta) * damping;
+        f32 vy = (data->enemy_vel_y[i] + push_y[i] * delta) * damping;
+        f32 x = data->enemy_x[i] + vx * delta;
+        f32 y = data->enemy_y[i] + vy * delta;
+
+        // Enemies do not cross chunks yet, they stop at the edge
+        vx = (x >= min_x && x <= max_x) ? vx : 0;
+        vy = (y >= min_y && y <= max_y) ? vy : 0;
+
+        data->enemy_x[i] = Clamp(x, min_x, max_x);
+        data->enemy_y[i] = Clamp(y, min_y, max_y);
+        data->enemy_vel_x[i] = vx;
+        data->enemy_vel_y[i] = vy;
+
+        f32 damage = data->enemy_damage[i];
+        data->enemy_hp[i] -= damage;
+        data->enemy_damage[i] = 0;
+
+        hurt |= (u64) (damage > 0) << i;
+        dead |= (u64) (data->enemy_hp[i] <= 0) << i;
+    }
+#endif
+
+    // Padding lanes hold garbage
+    u64 live = chunk->enemy_count == 64 ? ~0ull : (1ull << chunk->enemy_count) - 1;
+    data->enemy_hurt = hurt & live;
+    dead &= live;
+
+    // Highest first, so the enemy swapped in is always one that survived
+    u32 died = 0;
+    for (i32 i = chunk->enemy_count - 1; dead && i >= 0; --i)
+    {
+        if (dead & (1ull << i))
+        {
+            RemoveEnemy(chunk, i);
+            dead &= ~(1ull << i);
+            died++;
+        }
+    }
+
+    return died;
+}
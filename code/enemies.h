@@ -0,0 +1,30 @@
+#pragma once
+
+#include "defines.h"
+#include "game_math.h"
+#include "simd.h"
+#include "spatial_hash.h"
+#include "world.h"
+
+// Per tick enemy update, run as lane kernels over the chunk columns. Separation
+// reads the enemy grid, everything else only touches one chunk's columns.
+
+struct EnemyParams
+{
+    // Must not exceed the grid's cell size
+    f32 separation_radius;
+    f32 separation_strength;
+    // Fraction of the velocity lost per second
+    f32 drag;
+};
+
+// Writes the separation push of every item in the grid to push_x/push_y, indexed by id
+void ComputeSeparation(SpatialHash *hash, EnemyParams *params, f32 *push_x, f32 *push_y);
+
+// Applies the damage and the push of the chunk's enemies (push is indexed from the
+// chunk's first enemy and must have BATCH_WIDTH floats of slack), integrates them,
+// keeps them inside the chunk and removes the dead. Returns how many died.
+u32 UpdateChunkEnemies(Chunk *chunk, EnemyParams *params, f32 *push_x, f32 *push_y, f32 delta);
+
+// Swap removes the enemy, moving the last one into its place
+void RemoveEnemy(Chunk *chunk, u32 index);
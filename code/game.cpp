@@ -4,95 +4,174 @@
 #include "game.h"
 #include "memory.h"
 #include "game_math.h"
+#include "batch_math.h"
+#include "sampling.h"
+#include "spatial_hash.h"
+#include "enemies.h"
+#include "level.h"
+#include "transform.h"
+#include "world.h"
+#include "streaming.h"
 #include "platform.h"
 
 #include "memory.cpp"
 #include "game_math.cpp"
+#include "batch_math.cpp"
+#include "sampling.cpp"
+#include "spatial_hash.cpp"
+#include "enemies.cpp"
+#include "transform.cpp"
+#include "world.cpp"
+#include "streaming.cpp"
 #include "camera.cpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#include "level.cpp"
+
 // NOTE: Cpp context causes name mangling. sad :(
 extern "C"
 {
-    __declspec(dllexport) RenderData * __stdcall GameUpdate(GameInput *input_data, GameAssets *assets, u8 *memory);
-    __declspec(dllexport) void _stdcall GameInitialize(u8 *memory, u64 memory_size);
+    __declspec(dllexport) RenderData * __stdcall GameUpdate(GameInput *input_data, GameAssets *assets, PlatformApi *platform, u8 *memory);
+    __declspec(dllexport) void _stdcall GameInitialize(PlatformApi *platform, u8 *memory, u64 memory_size);
+    __declspec(dllexport) void _stdcall GameShutdown(PlatformApi *platform, u8 *memory);
 }
 
 GameInput *input;
 GameAssets *assets;
 GameState *state;
+PlatformApi *platform;
 
 // Rendering stuff...
 
-struct MultiDrawBuffer
+// Each buffer owns a fixed share of the renderer's mapped frame region, so the
+// quads of a buffer stay contiguous however the DrawQuad calls interleave.
+struct QuadBuffer
 {
-    i32 primitive_count;
-    i32 offsets[512];
-    i32 counts[512];
+    // Only ever written, see PlatformApi::frame_quads
+    QuadInstance *quads;
+    u32 first;
+    u32 count;
+    u32 capacity;
+
+    V2 bounds_min;
+    V2 bounds_max;
 };
 
-u32 vertex_count;
-Vertex vertex_buffer[4096];
+u32 quad_count;
+u32 quad_capacity;
+QuadInstance *frame_quads;
+
+QuadBuffer level_buffer;
+QuadBuffer debug_buffer;
+QuadBuffer entity_buffer;
+QuadBuffer player_buffer;
+
+u32 level_chunk_count;
+LevelChunk level_chunks[MAX_LEVEL_CHUNKS];
+
+void BeginQuadBuffer(QuadBuffer *buffer, u32 capacity)
+{
+    assert(quad_count + capacity <= quad_capacity);
+
+    *buffer = {};
+    buffer->quads = frame_quads + quad_count;
+    buffer->first = quad_count;
+    buffer->capacity = capacity;
+    quad_count += capacity;
+}
+
+inline QuadBatch BufferToBatch(QuadBuffer *buffer)
+{
+    QuadBatch batch = {};
+    batch.first = buffer->first;
+    batch.count = buffer->count;
+    batch.bounds_min = buffer->bounds_min;
+    batch.bounds_max = buffer->bounds_max;
+    return batch;
+}
+
+inline u32 PackColor(V3 color)
+{
+    u32 r = (u32) (Clamp(color.x, 0, 1) * 255 + 0.5f);
+    u32 g = (u32) (Clamp(color.y, 0, 1) * 255 + 0.5f);
+    u32 b = (u32) (Clamp(color.z, 0, 1) * 255 + 0.5f);
+    return r | (g << 8) | (b << 16) | (255u << 24);
+}
+
+RenderCommand *PushRenderCommand(RenderData *render, RenderCommandType type, RenderLayer layer)
+{
+    assert(render->command_count < lengthof(render->commands));
+
+    RenderCommand *command = render->commands + render->command_count++;
+    command->type = type;
+    command->layer = layer;
+    return command;
+}
 
-MultiDrawBuffer level_buffer;
-MultiDrawBuffer debug_buffer;
-MultiDrawBuffer entity_buffer;
-MultiDrawBuffer player_buffer;
+inline void PushQuads(RenderData *render, QuadBuffer *buffer, RenderLayer layer)
+{
+    if (buffer->count)
+    {
+        PushRenderCommand(render, RenderCommand_Quads, layer)->quads = BufferToBatch(buffer);
+    }
+}
 
-inline MultiDraw BufferToDraw(MultiDrawBuffer *buffer)
+inline void PushMesh(RenderData *render, Mesh mesh, Mat4 transform, V3 tint, RenderLayer layer)
 {
-    MultiDraw draw = {};
-    draw.primitive_count = buffer->primitive_count;
-    draw.offsets = buffer->offsets;
-    draw.counts = buffer->counts;
-    return draw;
+    RenderCommand *command = PushRenderCommand(render, RenderCommand_Mesh, layer);
+    command->mesh = mesh;
+    command->transform = transform;
+    command->tint = PackColor(tint);
 }
 
-void DrawQuad(MultiDrawBuffer *buffer, V2 topleft, V2 size, V3 color)
+void DrawQuad(QuadBuffer *buffer, V2 topleft, V2 size, V3 color)
 {
-    assert(vertex_count + 4 <= lengthof(vertex_buffer));
-    assert(buffer->primitive_count < lengthof(buffer->offsets));
-
-    Vertex *p0 = &vertex_buffer[vertex_count + 0];
-    p0->position = v3(topleft.x, topleft.y, 0);
-    p0->normal = v3(0, 0, 1);
-    p0->uv = v2(0, 0);
-    p0->color = color;
-
-    Vertex *p1 = &vertex_buffer[vertex_count + 1];
-    p1->position = v3(topleft.x + size.x, topleft.y, 0);
-    p1->normal = v3(0, 0, 1);
-    p1->uv = v2(0, 0);
-    p1->color = color;
-
-    Vertex *p2 = &vertex_buffer[vertex_count + 2];
-    p2->position = v3(topleft.x, topleft.y + size.y, 0);
-    p2->normal = v3(0, 0, 1);
-    p2->uv = v2(0, 0);
-    p2->color = color;
-
-    Vertex *p3 = &vertex_buffer[vertex_count + 3];
-    p3->position = v3(topleft.x + size.x, topleft.y + size.y, 0);
-    p3->normal = v3(0, 0, 1);
-    p3->uv = v2(0, 0);
-    p3->color = color;
-
-    u32 primitive = buffer->primitive_count;
-    buffer->offsets[primitive] = vertex_count;
-    buffer->counts[primitive] = 4;
-
-    vertex_count += 4;
-    buffer->primitive_count++;
+    assert(buffer->count < buffer->capacity);
+
+    QuadInstance *quad = buffer->quads + buffer->count;
+    quad->topleft = topleft;
+    quad->size = size;
+    quad->color = PackColor(color);
+
+    V2 min = v2(Min(topleft.x, topleft.x + size.x), Min(topleft.y, topleft.y + size.y));
+    V2 max = v2(Max(topleft.x, topleft.x + size.x), Max(topleft.y, topleft.y + size.y));
+    if (buffer->count == 0)
+    {
+        buffer->bounds_min = min;
+        buffer->bounds_max = max;
+    }
+    else
+    {
+        buffer->bounds_min = v2(Min(buffer->bounds_min.x, min.x), Min(buffer->bounds_min.y, min.y));
+        buffer->bounds_max = v2(Max(buffer->bounds_max.x, max.x), Max(buffer->bounds_max.y, max.y));
+    }
+
+    buffer->count++;
 }
 
 void LoadState()
 {
+    World *world = &state->world;
+
+    // Jobs in flight point at chunks that are about to go away
+    FlushStreaming(&state->streamer, world, platform);
+    ClearWorld(world);
+
+    bool loaded = LoadLevel(world, platform, "assets/level_0.png", "assets/level_0.lvl", &state->level);
+    assert(loaded);
+
+    Player *player = &state->player;
+    player->target_position = (v2(state->level.player_tile_x, state->level.player_tile_y) + v2(0.5)) * TILE_SIZE;
+    player->smooth_position = player->target_position;
+    player->target_velocity = {};
+    player->smooth_velocity = {};
 }
 
-void GameInitialize(u8 *memory, u64 memory_size)
+void GameInitialize(PlatformApi *platform_api, u8 *memory, u64 memory_size)
 {
+    platform = platform_api;
     state = (GameState *) memory;
     *state = {};
 
@@ -101,32 +180,120 @@ void GameInitialize(u8 *memory, u64 memory_size)
     arena->capacity = memory_size;
     arena->offset = sizeof(GameState);
 
+    // The dll has its own scratch arena, it lives in game memory so it survives reloads
+    state->scratch_memory.capacity = MegaByte(1);
+    state->scratch_memory.memory = PushBytes(arena, state->scratch_memory.capacity);
+    scratch = state->scratch_memory;
+
+    state->world_memory.capacity = MegaByte(4);
+    state->world_memory.memory = PushBytes(arena, state->world_memory.capacity);
+    InitializeWorld(&state->world, &state->world_memory, 1024, MAX_CHUNK_DATA);
+
+    StreamConfig stream_config = {};
+    stream_config.radius = 3;
+    stream_config.max_resident_chunks = 256;
+    stream_config.max_resident_bytes = MegaByte(1);
+    stream_config.serialize = true;
+    InitializeStreamer(&state->streamer, stream_config);
+
+    // Cells of two tiles, a bit over the separation radius, so separation only
+    // visits a handful of enemies per cell
+    state->enemy_positions = PushV2Batch(arena, MAX_ENEMIES);
+    state->enemy_push_x = PushArrayZero(arena, f32, MAX_ENEMIES + BATCH_WIDTH);
+    state->enemy_push_y = PushArrayZero(arena, f32, MAX_ENEMIES + BATCH_WIDTH);
+    state->enemy_hash = PushSpatialHash(arena, MAX_ENEMIES, 16384, 2 * TILE_SIZE);
+
     LoadState();
 
     InitializeCamera(&state->camera, v3(0, 0, 50), v3(0, 0, -1));
 }
 
-RenderData *GameUpdate(GameInput *input_data, GameAssets *asset_data, u8 *memory)
+void GameShutdown(PlatformApi *platform_api, u8 *memory)
+{
+    platform = platform_api;
+    state = (GameState *) memory;
+
+    // Saves the modified chunks that are still resident
+    FlushStreaming(&state->streamer, &state->world, platform);
+}
+
+RenderData *GameUpdate(GameInput *input_data, GameAssets *asset_data, PlatformApi *platform_api, u8 *memory)
 {
     input = input_data;
     assets = asset_data;
+    platform = platform_api;
     state = (GameState *) memory;
+    scratch = state->scratch_memory;
     f32 delta = input->delta;
 
-    vertex_count = {};
-    level_buffer = {};
-    debug_buffer = {};
-    entity_buffer = {};
-    player_buffer = {};
+    quad_count = 0;
+    frame_quads = platform->frame_quads;
+    quad_capacity = platform->frame_quad_capacity;
+    BeginQuadBuffer(&level_buffer, quad_capacity / 4);
+    BeginQuadBuffer(&debug_buffer, quad_capacity / 4);
+    BeginQuadBuffer(&entity_buffer, quad_capacity / 4);
+    BeginQuadBuffer(&player_buffer, quad_capacity / 4);
 
     if (KeyJustDown(Key_R))
     {
         LoadState();
     }
 
+    RenderData *render = &state->render_data;
+    if (KeyJustDown(Key_T))
+    {
+        render->level_mode = (LevelRenderMode) ((render->level_mode + 1) % LevelRender_Count);
+    }
+
+    if (KeyJustDown(Key_C))
+    {
+        render->orthographic = !render->orthographic;
+    }
+
     UpdateCamera(&state->camera);
     UpdateCameraMouse(&state->camera);
 
+    Player *player = &state->player;
+    player->chunk_x = ChunkCoordinate((i32) Floor(player->target_position.x / TILE_SIZE));
+    player->chunk_y = ChunkCoordinate((i32) Floor(player->target_position.y / TILE_SIZE));
+    UpdateStreaming(&state->streamer, &state->world, platform, player->chunk_x, player->chunk_y);
+
+    // Gather every resident enemy in chunk order, so a chunk's enemies are one
+    // contiguous range of grid ids starting at its base
+    World *world = &state->world;
+    V2Batch *enemy_positions = &state->enemy_positions;
+    TempMemory temp = ScratchAllocate();
+    u32 *enemy_base = PushArray(temp.arena, u32, world->chunk_count);
+
+    enemy_positions->count = 0;
+    for (u32 i = 0; i < world->chunk_count; ++i)
+    {
+        Chunk *chunk = world->chunks + i;
+        enemy_base[i] = enemy_positions->count;
+        if (chunk->enemy_count)
+        {
+            memcpy(enemy_positions->x + enemy_positions->count, chunk->data->enemy_x, sizeof(f32) * chunk->enemy_count);
+            memcpy(enemy_positions->y + enemy_positions->count, chunk->data->enemy_y, sizeof(f32) * chunk->enemy_count);
+            enemy_positions->count += chunk->enemy_count;
+        }
+    }
+    BuildSpatialHash(&state->enemy_hash, enemy_positions);
+
+    EnemyParams enemy_params = {};
+    enemy_params.separation_radius = TILE_SIZE;
+    enemy_params.separation_strength = TILE_SIZE * TILE_SIZE;
+    enemy_params.drag = 0.5;
+
+    ComputeSeparation(&state->enemy_hash, &enemy_params, state->enemy_push_x, state->enemy_push_y);
+    for (u32 i = 0; i < world->chunk_count; ++i)
+    {
+        Chunk *chunk = world->chunks + i;
+        u32 base = enemy_base[i];
+        UpdateChunkEnemies(chunk, &enemy_params, state->enemy_push_x + base, state->enemy_push_y + base, delta);
+    }
+
+    EndTempRegion(temp);
+
     // We render at 960 x 540
     // 0,0 ------------> 960,0
     // |
@@ -136,25 +303,42 @@ RenderData *GameUpdate(GameInput *input_data, GameAssets *asset_data, u8 *memory
     // |
     // 0,540
 
-    RenderData *render = &state->render_data;
+    UpdateWorldTransforms(&assets->scene);
+
+    render->command_count = 0;
+    PushMesh(render, assets->alien, assets->scene.world[assets->alien_node], v3(1), RenderLayer_World);
 
-    render->mesh_count = 1;
-    render->meshes[0] = assets->alien;
+    // The renderer meshes the tiles itself and keeps them until their version changes
+    static_assert(Tile_Count <= MAX_TILE_TYPES, "tile palette is too small");
+    render->tile_colors[Tile_Wall] = v3(0.1, 0.1, 0.1);
+    render->tile_colors[Tile_Floor] = v3(0.2, 0.8, 0.2);
+    render->tile_colors[Tile_EnemySpawn] = v3(0.8, 0.2, 0.2);
+    render->tile_colors[Tile_PlayerSpawn] = v3(0.2, 0.2, 0.8);
 
-    for (u32 y = 0; y < 16; ++y)
+    level_chunk_count = 0;
+    for (u32 i = 0; i < world->chunk_count; ++i)
     {
-        for (u32 x = 0; x < 16; ++x)
+        Chunk *chunk = world->chunks + i;
+        if (!(chunk->flags & ChunkFlag_HasTiles))
         {
-            DrawQuad(&level_buffer, v2(x * 32, y * 32), v2(32), v3(0.2, 0.8, 0.2));
+            continue;
         }
+
+        assert(level_chunk_count < lengthof(level_chunks));
+        LevelChunk *level_chunk = level_chunks + level_chunk_count++;
+        level_chunk->x = chunk->x;
+        level_chunk->y = chunk->y;
+        level_chunk->version = chunk->tile_version;
+        level_chunk->tiles = chunk->data->tiles;
     }
 
-    render->vertex_count = vertex_count;
-    render->vertex_buffer = vertex_buffer;
-    render->debug = BufferToDraw(&debug_buffer);
-    render->level = BufferToDraw(&level_buffer);
-    render->entities = BufferToDraw(&entity_buffer);
-    render->player = BufferToDraw(&player_buffer);
+    render->level_chunk_count = level_chunk_count;
+    render->level_chunks = level_chunks;
+    PushRenderCommand(render, RenderCommand_Level, RenderLayer_Level);
+    PushQuads(render, &level_buffer, RenderLayer_Level);
+    PushQuads(render, &entity_buffer, RenderLayer_World);
+    PushQuads(render, &player_buffer, RenderLayer_World);
+    PushQuads(render, &debug_buffer, RenderLayer_Debug);
 
     render->camera_pos = state->camera.pos;
     render->camera_forward = state->camera.front;
@@ -4,10 +4,19 @@
 #include "memory.h"
 #include "platform.h"
 #include "camera.h"
+#include "world.h"
+#include "streaming.h"
+#include "batch_math.h"
+#include "spatial_hash.h"
+#include "enemies.h"
+#include "level.h"
 
 #include <assert.h>
 
 
+#define MAX_CHUNK_DATA 1024
+#define MAX_ENEMIES (MAX_CHUNK_DATA * CHUNK_ENEMY_CAPACITY)
+
 struct Player
 {
     u32 flags;
@@ -21,44 +30,26 @@ struct Player
     i32 chunk_y;
 };
 
-struct Enemy
-{
-    u32 flags;
-    V2 position;
-};
-
-struct Tower
-{
-    i32 tile_x;
-    i32 tile_y;
-};
-
-struct Chunk
-{
-    u32 width;
-    u32 height;
-
-    u32 enemy_count;
-    Enemy enemies[64];
-
-    u32 tower_count;
-    Tower towers[64];
-};
-
-struct World
-{
-    i32 width;
-    i32 height;
-    Chunk *chunks;
-};
-
 struct GameState
 {
     Arena memory;
     Arena world_memory;
+    Arena scratch_memory;
     RenderData render_data;
 
     Camera camera;
+    Player player;
+    Level level;
+
+    World world;
+    ChunkStreamer streamer;
+
+    // Positions of every resident enemy, gathered each tick, and the grid over them
+    V2Batch enemy_positions;
+    SpatialHash enemy_hash;
+    // Separation push by grid id, with BATCH_WIDTH slack for the chunk kernels
+    f32 *enemy_push_x;
+    f32 *enemy_push_y;
 };
 
 extern GameInput *input;
@@ -2,165 +2,339 @@
 
 #include <math.h>
 
-f32 Halton(u32 i, u32 b)
-{
-    f32 f = 1;
-    f32 r = 0;
-    while (i > 0) {
-        f = f / b;
-        r += f * (i % b);
-        i = floor(i / b);
-    }
+// SIMD helpers...
+//
 
-    return r;
-}
-
-f32 Floor(f32 a)
-{
-    return floor(a);
-}
+#ifdef MATH_SSE
 
-V2 V2::operator*(f32 t)
-{
-    return {x * t, y * t};
-}
+#define ShuffleMask(x, y, z, w) ((x) | ((y) << 2) | ((z) << 4) | ((w) << 6))
+#define Shuffle(a, b, x, y, z, w) _mm_shuffle_ps(a, b, ShuffleMask(x, y, z, w))
+#define Swizzle(a, x, y, z, w) _mm_shuffle_ps(a, a, ShuffleMask(x, y, z, w))
+#define Swizzle1(a, x) _mm_shuffle_ps(a, a, ShuffleMask(x, x, x, x))
 
-V2 V2::operator/(f32 t)
+// Cross product of the xyz lanes, w ends up 0
+inline __m128 Cross(__m128 a, __m128 b)
 {
-    return {x / t, y / t};
+    __m128 a_yzx = Swizzle(a, 1, 2, 0, 3);
+    __m128 b_yzx = Swizzle(b, 1, 2, 0, 3);
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+    return Swizzle(c, 1, 2, 0, 3);
 }
 
-V2 V2::operator+(V2 b)
+inline __m128 Dot3(__m128 a, __m128 b)
 {
-    return {x + b.x, y + b.y};
+    __m128 m = _mm_mul_ps(a, b);
+    __m128 x = Swizzle1(m, 0);
+    __m128 y = Swizzle1(m, 1);
+    __m128 z = Swizzle1(m, 2);
+    return _mm_add_ps(_mm_add_ps(x, y), z);
 }
 
-V2 V2::operator-(V2 b)
+// 2x2 row major block products used by Inverse
+inline __m128 Mat2Mul(__m128 a, __m128 b)
 {
-    return {x - b.x, y - b.y};
+    return _mm_add_ps(_mm_mul_ps(a, Swizzle(b, 0, 3, 0, 3)),
+                      _mm_mul_ps(Swizzle(a, 1, 0, 3, 2), Swizzle(b, 2, 1, 2, 1)));
 }
 
-
-void V2::operator+=(V2 b)
+// adj(a) * b
+inline __m128 Mat2AdjMul(__m128 a, __m128 b)
 {
-    x += b.x;
-    y += b.y;
+    return _mm_sub_ps(_mm_mul_ps(Swizzle(a, 3, 3, 0, 0), b),
+                      _mm_mul_ps(Swizzle(a, 1, 1, 2, 2), Swizzle(b, 2, 3, 0, 1)));
 }
 
-V3 V3::operator/(f32 t)
+// a * adj(b)
+inline __m128 Mat2MulAdj(__m128 a, __m128 b)
 {
-    return {x / t, y / t, z / t};
+    return _mm_sub_ps(_mm_mul_ps(a, Swizzle(b, 3, 0, 3, 0)),
+                      _mm_mul_ps(Swizzle(a, 1, 0, 3, 2), Swizzle(b, 2, 1, 2, 1)));
 }
 
-V3 V3::operator-(V3 b)
-{
-    return {x - b.x, y - b.y, z - b.z};
-}
+#endif
 
-V3 V3::operator+(V3 b)
-{
-    return {x + b.x, y + b.y, z + b.z};
-}
+// Matrices...
+//
 
-void V3::operator+=(V3 b)
+Mat4 Inverse(Mat4 m)
 {
-    x += b.x;
-    y += b.y;
-    z += b.z;
-}
+    Mat4 res;
 
-V2 Norm(V2 a)
-{
-    f32 square_length = a.x * a.x + a.y * a.y;
-    if (square_length < 0.001)
-    {
-        return v2(0);
+#ifdef MATH_SSE
+    // Block matrix inverse on 2x2 sub matrices. Works on columns the same way it
+    // works on rows since inverse(transpose(M)) == transpose(inverse(M)).
+    __m128 c0 = _mm_load_ps(m.v + 0);
+    __m128 c1 = _mm_load_ps(m.v + 4);
+    __m128 c2 = _mm_load_ps(m.v + 8);
+    __m128 c3 = _mm_load_ps(m.v + 12);
+
+    __m128 a = _mm_movelh_ps(c0, c1);
+    __m128 b = _mm_movehl_ps(c1, c0);
+    __m128 c = _mm_movelh_ps(c2, c3);
+    __m128 d = _mm_movehl_ps(c3, c2);
+
+    // (|A|, |B|, |C|, |D|)
+    __m128 det_sub = _mm_sub_ps(_mm_mul_ps(Shuffle(c0, c2, 0, 2, 0, 2), Shuffle(c1, c3, 1, 3, 1, 3)),
+                                _mm_mul_ps(Shuffle(c0, c2, 1, 3, 1, 3), Shuffle(c1, c3, 0, 2, 0, 2)));
+    __m128 det_a = Swizzle1(det_sub, 0);
+    __m128 det_b = Swizzle1(det_sub, 1);
+    __m128 det_c = Swizzle1(det_sub, 2);
+    __m128 det_d = Swizzle1(det_sub, 3);
+
+    __m128 d_c = Mat2AdjMul(d, c);
+    __m128 a_b = Mat2AdjMul(a, b);
+
+    __m128 x = _mm_sub_ps(_mm_mul_ps(det_d, a), Mat2Mul(b, d_c));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(det_a, d), Mat2Mul(c, a_b));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(det_b, c), Mat2MulAdj(d, a_b));
+    __m128 z = _mm_sub_ps(_mm_mul_ps(det_c, b), Mat2MulAdj(a, d_c));
+
+    // |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+    __m128 tr = _mm_mul_ps(a_b, Swizzle(d_c, 0, 2, 1, 3));
+    tr = _mm_add_ps(tr, Swizzle(tr, 2, 3, 0, 1));
+    tr = _mm_add_ps(tr, Swizzle(tr, 1, 0, 3, 2));
+    __m128 det = _mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c));
+    det = _mm_sub_ps(det, tr);
+
+    __m128 inv_det = _mm_div_ps(_mm_setr_ps(1, -1, -1, 1), det);
+    x = _mm_mul_ps(x, inv_det);
+    y = _mm_mul_ps(y, inv_det);
+    z = _mm_mul_ps(z, inv_det);
+    w = _mm_mul_ps(w, inv_det);
+
+    _mm_store_ps(res.v + 0, Shuffle(x, y, 3, 1, 3, 1));
+    _mm_store_ps(res.v + 4, Shuffle(x, y, 2, 0, 2, 0));
+    _mm_store_ps(res.v + 8, Shuffle(z, w, 3, 1, 3, 1));
+    _mm_store_ps(res.v + 12, Shuffle(z, w, 2, 0, 2, 0));
+#else
+    f32 *a = m.v;
+    f32 *r = res.v;
+
+    r[0] = a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15] + a[9] * a[7] * a[14] + a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+    r[4] = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15] - a[8] * a[7] * a[14] - a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+    r[8] = a[4] * a[9] * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15] + a[8] * a[7] * a[13] + a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+    r[12] = -a[4] * a[9] * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14] - a[8] * a[6] * a[13] - a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+    r[1] = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15] - a[9] * a[3] * a[14] - a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+    r[5] = a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15] + a[8] * a[3] * a[14] + a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+    r[9] = -a[0] * a[9] * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15] - a[8] * a[3] * a[13] - a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+    r[13] = a[0] * a[9] * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14] + a[8] * a[2] * a[13] + a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+    r[2] = a[1] * a[6] * a[15] - a[1] * a[7] * a[14] - a[5] * a[2] * a[15] + a[5] * a[3] * a[14] + a[13] * a[2] * a[7] - a[13] * a[3] * a[6];
+    r[6] = -a[0] * a[6] * a[15] + a[0] * a[7] * a[14] + a[4] * a[2] * a[15] - a[4] * a[3] * a[14] - a[12] * a[2] * a[7] + a[12] * a[3] * a[6];
+    r[10] = a[0] * a[5] * a[15] - a[0] * a[7] * a[13] - a[4] * a[1] * a[15] + a[4] * a[3] * a[13] + a[12] * a[1] * a[7] - a[12] * a[3] * a[5];
+    r[14] = -a[0] * a[5] * a[14] + a[0] * a[6] * a[13] + a[4] * a[1] * a[14] - a[4] * a[2] * a[13] - a[12] * a[1] * a[6] + a[12] * a[2] * a[5];
+    r[3] = -a[1] * a[6] * a[11] + a[1] * a[7] * a[10] + a[5] * a[2] * a[11] - a[5] * a[3] * a[10] - a[9] * a[2] * a[7] + a[9] * a[3] * a[6];
+    r[7] = a[0] * a[6] * a[11] - a[0] * a[7] * a[10] - a[4] * a[2] * a[11] + a[4] * a[3] * a[10] + a[8] * a[2] * a[7] - a[8] * a[3] * a[6];
+    r[11] = -a[0] * a[5] * a[11] + a[0] * a[7] * a[9] + a[4] * a[1] * a[11] - a[4] * a[3] * a[9] - a[8] * a[1] * a[7] + a[8] * a[3] * a[5];
+    r[15] = a[0] * a[5] * a[10] - a[0] * a[6] * a[9] - a[4] * a[1] * a[10] + a[4] * a[2] * a[9] + a[8] * a[1] * a[6] - a[8] * a[2] * a[5];
+
+    f32 inv_det = 1 / (a[0] * r[0] + a[1] * r[4] + a[2] * r[8] + a[3] * r[12]);
+    for (u32 i = 0; i < 16; ++i) {
+        r[i] *= inv_det;
     }
+#endif
 
-    f32 length = sqrt(square_length);
-    return a / length;
+    return res;
 }
 
-V3 Norm(V3 a)
+Mat4 AffineInverse(Mat4 m)
 {
-    f32 length = sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
-    return a / length;
-}
+    Mat4 res;
 
-Mat4 Ortho(f32 l, f32 r, f32 b, f32 t, f32 n, f32 f)
-{
-    return {
-        2/(r-l), 0, 0, 0,
-        0, 2/(t-b), 0, 0,
-        0, 0, -2/(f-n), 0,
-        -(r+l)/(r-l), -(t+b)/(t-b), -(f+n)/(f-n), 1,
+#ifdef MATH_SSE
+    __m128 c0 = _mm_load_ps(m.v + 0);
+    __m128 c1 = _mm_load_ps(m.v + 4);
+    __m128 c2 = _mm_load_ps(m.v + 8);
+    __m128 t = _mm_load_ps(m.v + 12);
+
+    // Rows of the inverse 3x3 are the cross products of the columns over the determinant
+    __m128 r0 = Cross(c1, c2);
+    __m128 r1 = Cross(c2, c0);
+    __m128 r2 = Cross(c0, c1);
+    __m128 inv_det = _mm_div_ps(_mm_set1_ps(1), Dot3(c0, r0));
+    r0 = _mm_mul_ps(r0, inv_det);
+    r1 = _mm_mul_ps(r1, inv_det);
+    r2 = _mm_mul_ps(r2, inv_det);
+
+    __m128 r3 = _mm_setr_ps(0, 0, 0, 1);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+    // r0..r2 are now the columns of the inverse 3x3, r3 is (0, 0, 0, 1)
+    __m128 inv_t = _mm_mul_ps(r0, Swizzle1(t, 0));
+    inv_t = MulAdd(r1, Swizzle1(t, 1), inv_t);
+    inv_t = MulAdd(r2, Swizzle1(t, 2), inv_t);
+    inv_t = _mm_sub_ps(r3, inv_t);
+
+    _mm_store_ps(res.v + 0, r0);
+    _mm_store_ps(res.v + 4, r1);
+    _mm_store_ps(res.v + 8, r2);
+    _mm_store_ps(res.v + 12, inv_t);
+#else
+    V3 c0 = v3(m.v[0], m.v[1], m.v[2]);
+    V3 c1 = v3(m.v[4], m.v[5], m.v[6]);
+    V3 c2 = v3(m.v[8], m.v[9], m.v[10]);
+    V3 t = v3(m.v[12], m.v[13], m.v[14]);
+
+    V3 r0 = Cross(c1, c2);
+    V3 r1 = Cross(c2, c0);
+    V3 r2 = Cross(c0, c1);
+    f32 det = Dot(c0, r0);
+    r0 = r0 / det;
+    r1 = r1 / det;
+    r2 = r2 / det;
+
+    res = {
+        r0.x, r1.x, r2.x, 0,
+        r0.y, r1.y, r2.y, 0,
+        r0.z, r1.z, r2.z, 0,
+        -Dot(r0, t), -Dot(r1, t), -Dot(r2, t), 1,
     };
-}
-
-Mat4 perspective(f32 fov, f32 aspect, f32 near_plane, f32 far_plane)
-{
-    Mat4 res = {};
-
-    float tan_fov = tan(fov / 2);
-    res.v[0] = 1.0f / (tan_fov * aspect);
-    res.v[5] = 1.0f / (tan_fov);
-    res.v[10] = -(far_plane + near_plane) / (far_plane - near_plane);
-    res.v[11] = -1;
-    res.v[14] = -(2 * near_plane * far_plane) / (far_plane - near_plane);
+#endif
 
     return res;
 }
 
-Mat4 LookAt(V3 eye, V3 target, V3 up)
+Mat4 NormalMatrix(Mat4 m)
 {
-    Mat4 res = {};
+    Mat4 res;
 
-    V3 f = Norm(target - eye);
-    V3 s = Norm(Cross(f, up));
-    V3 u = Cross(s, f);
+#ifdef MATH_SSE
+    __m128 c0 = _mm_load_ps(m.v + 0);
+    __m128 c1 = _mm_load_ps(m.v + 4);
+    __m128 c2 = _mm_load_ps(m.v + 8);
+
+    // The cofactor columns are already the transposed inverse
+    __m128 n0 = Cross(c1, c2);
+    __m128 n1 = Cross(c2, c0);
+    __m128 n2 = Cross(c0, c1);
+    __m128 inv_det = _mm_div_ps(_mm_set1_ps(1), Dot3(c0, n0));
+
+    _mm_store_ps(res.v + 0, _mm_mul_ps(n0, inv_det));
+    _mm_store_ps(res.v + 4, _mm_mul_ps(n1, inv_det));
+    _mm_store_ps(res.v + 8, _mm_mul_ps(n2, inv_det));
+    _mm_store_ps(res.v + 12, _mm_setr_ps(0, 0, 0, 1));
+#else
+    V3 c0 = v3(m.v[0], m.v[1], m.v[2]);
+    V3 c1 = v3(m.v[4], m.v[5], m.v[6]);
+    V3 c2 = v3(m.v[8], m.v[9], m.v[10]);
+
+    f32 det = Dot(c0, Cross(c1, c2));
+    V3 n0 = Cross(c1, c2) / det;
+    V3 n1 = Cross(c2, c0) / det;
+    V3 n2 = Cross(c0, c1) / det;
+
+    res = {
+        n0.x, n0.y, n0.z, 0,
+        n1.x, n1.y, n1.z, 0,
+        n2.x, n2.y, n2.z, 0,
+        0, 0, 0, 1,
+    };
+#endif
 
-    res.v[0] = s.x;
-    res.v[4] = s.y;
-    res.v[8] = s.z;
+    return res;
+}
 
-    res.v[1] = u.x;
-    res.v[5] = u.y;
-    res.v[9] = u.z;
+// Transforms...
+//
 
-    res.v[2] = -f.x;
-    res.v[6] = -f.y;
-    res.v[10] = -f.z;
+// w is 1 for points and 0 for vectors. The batches are transposed to xxxx/yyyy/zzzz
+// in registers, so every lane does one full V3 and the matrix is only broadcast once.
+void TransformV3s(Mat4 *m, V3 *in, V3 *out, u32 count, f32 w)
+{
+    u32 i = 0;
 
-    res.v[12] = -Dot(s, eye);
-    res.v[13] = -Dot(u, eye);
-    res.v[14] = Dot(f, eye);
+#ifdef MATH_SSE
+    f32 *src = (f32 *) in;
+    f32 *dst = (f32 *) out;
+#endif
 
-    res.v[15] = 1;
+#ifdef MATH_AVX
+    __m256 m8[9];
+    for (u32 k = 0; k < 9; ++k) {
+        m8[k] = _mm256_set1_ps(m->v[k + k / 3]);
+    }
+    __m256 tx = _mm256_set1_ps(m->v[12] * w);
+    __m256 ty = _mm256_set1_ps(m->v[13] * w);
+    __m256 tz = _mm256_set1_ps(m->v[14] * w);
+
+    for (; i + 8 <= count; i += 8) {
+        f32 *s = src + 3 * i;
+        __m256 m03 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(s + 0)), _mm_loadu_ps(s + 12), 1);
+        __m256 m14 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(s + 4)), _mm_loadu_ps(s + 16), 1);
+        __m256 m25 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(s + 8)), _mm_loadu_ps(s + 20), 1);
+
+        __m256 xy = _mm256_shuffle_ps(m14, m25, ShuffleMask(2, 3, 1, 2));
+        __m256 yz = _mm256_shuffle_ps(m03, m14, ShuffleMask(1, 2, 0, 1));
+        __m256 x = _mm256_shuffle_ps(m03, xy, ShuffleMask(0, 3, 0, 2));
+        __m256 y = _mm256_shuffle_ps(yz, xy, ShuffleMask(0, 2, 1, 3));
+        __m256 z = _mm256_shuffle_ps(yz, m25, ShuffleMask(1, 3, 0, 3));
+
+        __m256 rx = MulAdd(m8[0], x, MulAdd(m8[3], y, MulAdd(m8[6], z, tx)));
+        __m256 ry = MulAdd(m8[1], x, MulAdd(m8[4], y, MulAdd(m8[7], z, ty)));
+        __m256 rz = MulAdd(m8[2], x, MulAdd(m8[5], y, MulAdd(m8[8], z, tz)));
+
+        __m256 rxy = _mm256_shuffle_ps(rx, ry, ShuffleMask(0, 2, 0, 2));
+        __m256 ryz = _mm256_shuffle_ps(ry, rz, ShuffleMask(1, 3, 1, 3));
+        __m256 rzx = _mm256_shuffle_ps(rz, rx, ShuffleMask(0, 2, 1, 3));
+        __m256 r03 = _mm256_shuffle_ps(rxy, rzx, ShuffleMask(0, 2, 0, 2));
+        __m256 r14 = _mm256_shuffle_ps(ryz, rxy, ShuffleMask(0, 2, 1, 3));
+        __m256 r25 = _mm256_shuffle_ps(rzx, ryz, ShuffleMask(1, 3, 1, 3));
+
+        f32 *d = dst + 3 * i;
+        _mm_storeu_ps(d + 0, _mm256_castps256_ps128(r03));
+        _mm_storeu_ps(d + 4, _mm256_castps256_ps128(r14));
+        _mm_storeu_ps(d + 8, _mm256_castps256_ps128(r25));
+        _mm_storeu_ps(d + 12, _mm256_extractf128_ps(r03, 1));
+        _mm_storeu_ps(d + 16, _mm256_extractf128_ps(r14, 1));
+        _mm_storeu_ps(d + 20, _mm256_extractf128_ps(r25, 1));
+    }
+#endif
 
-    return res;
+#ifdef MATH_SSE
+    __m128 m4[9];
+    for (u32 k = 0; k < 9; ++k) {
+        m4[k] = _mm_set1_ps(m->v[k + k / 3]);
+    }
+    __m128 tx4 = _mm_set1_ps(m->v[12] * w);
+    __m128 ty4 = _mm_set1_ps(m->v[13] * w);
+    __m128 tz4 = _mm_set1_ps(m->v[14] * w);
+
+    for (; i + 4 <= count; i += 4) {
+        f32 *s = src + 3 * i;
+        __m128 a = _mm_loadu_ps(s + 0);
+        __m128 b = _mm_loadu_ps(s + 4);
+        __m128 c = _mm_loadu_ps(s + 8);
+
+        __m128 x = Shuffle(a, Shuffle(b, c, 2, 0, 1, 0), 0, 3, 0, 2);
+        __m128 y = Shuffle(Shuffle(a, b, 1, 1, 0, 0), Shuffle(b, c, 3, 3, 2, 2), 0, 2, 0, 2);
+        __m128 z = Shuffle(Shuffle(a, b, 2, 2, 1, 1), Swizzle(c, 0, 0, 3, 3), 0, 2, 0, 2);
+
+        __m128 rx = MulAdd(m4[0], x, MulAdd(m4[3], y, MulAdd(m4[6], z, tx4)));
+        __m128 ry = MulAdd(m4[1], x, MulAdd(m4[4], y, MulAdd(m4[7], z, ty4)));
+        __m128 rz = MulAdd(m4[2], x, MulAdd(m4[5], y, MulAdd(m4[8], z, tz4)));
+
+        f32 *d = dst + 3 * i;
+        _mm_storeu_ps(d + 0, Shuffle(Shuffle(rx, ry, 0, 0, 0, 0), Shuffle(rz, rx, 0, 0, 1, 1), 0, 2, 0, 2));
+        _mm_storeu_ps(d + 4, Shuffle(Shuffle(ry, rz, 1, 1, 1, 1), Shuffle(rx, ry, 2, 2, 2, 2), 0, 2, 0, 2));
+        _mm_storeu_ps(d + 8, Shuffle(Shuffle(rz, rx, 2, 2, 3, 3), Shuffle(ry, rz, 3, 3, 3, 3), 0, 2, 0, 2));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        V3 p = in[i];
+        out[i] = {
+            m->v[0] * p.x + m->v[4] * p.y + m->v[8] * p.z + m->v[12] * w,
+            m->v[1] * p.x + m->v[5] * p.y + m->v[9] * p.z + m->v[13] * w,
+            m->v[2] * p.x + m->v[6] * p.y + m->v[10] * p.z + m->v[14] * w,
+        };
+    }
 }
 
-Mat4 Mat4::operator*(Mat4 b)
+void TransformPoints(Mat4 m, V3 *in, V3 *out, u32 count)
 {
-    Mat4 res;
-
-    for (u32 i = 0; i < 4; ++i) {
-        for (u32 j = 0; j < 4; ++j) {
-            float acc = 0;
-            for (u32 k = 0; k < 4; ++k) {
-                acc += v[i + 4 * k] * b.v[4 * j + k];
-            }
-            res.v[i + 4 * j] = acc;
-        }
-    }
-
-    return res;
+    TransformV3s(&m, in, out, count, 1);
 }
 
-bool AABBCollision(V2 bl0, V2 tr0, V2 bl1, V2 tr1)
+void TransformVectors(Mat4 m, V3 *in, V3 *out, u32 count)
 {
-    return  bl0.x <= tr1.x &&
-            tr0.x >= bl1.x &&
-            bl0.y <= tr1.y &&
-            tr0.y >= bl1.y;
+    TransformV3s(&m, in, out, count, 0);
 }
@@ -2,119 +2,587 @@
 
 #include "defines.h"
 
+#include <math.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Define MATH_SCALAR to build the plain C++ fallback instead of the SSE/AVX paths.
+#if !defined(MATH_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MATH_SSE
+#include <immintrin.h>
+#if defined(__AVX__)
+#define MATH_AVX
+#endif
+#if defined(__FMA__) || defined(__AVX2__)
+#define MATH_FMA
+#endif
+#endif
+
 #define PI 3.1415
 
-f32 Floor(f32 a);
+// Everything the game touches per vertex or per entity lives in this header as
+// inline/constexpr, so it inlines no matter which translation unit includes it.
+
+inline f32 Floor(f32 a)
+{
+    return floorf(a);
+}
 
-f32 Halton(u32 i, u32 b);
+inline f32 Sqrt(f32 a)
+{
+    return sqrtf(a);
+}
 
-inline f32 Min(f32 a, f32 b)
+constexpr f32 Min(f32 a, f32 b)
 {
     return a < b ? a : b;
 }
 
-inline f32 Max(f32 a, f32 b)
+constexpr f32 Max(f32 a, f32 b)
 {
     return a < b ? b : a;
 }
 
-inline f32 Abs(f32 a)
+constexpr f32 Abs(f32 a)
+{
+    return a > 0 ? a : -a;
+}
+
+constexpr i32 Abs(i32 a)
 {
     return a > 0 ? a : -a;
 }
 
+constexpr f32 Clamp(f32 a, f32 min, f32 max)
+{
+    return a < min ? min : (a > max ? max : a);
+}
+
+constexpr f32 Lerp(f32 a, f32 b, f32 t)
+{
+    return a + (b - a) * t;
+}
+
+// a must not be 0
+inline u32 CountTrailingZeros(u32 a)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, a);
+    return index;
+#else
+    return __builtin_ctz(a);
+#endif
+}
+
 inline f32 Round(f32 a)
 {
     return Floor(a + 0.5);
 }
 
+constexpr f32 Radians(f32 a)
+{
+    return a / 180 * PI;
+}
+
+// V2i...
+//
+
 struct V2i
 {
     i32 x;
     i32 y;
 };
 
-inline V2i v2i(i32 x, i32 y)
+constexpr V2i v2i(i32 x, i32 y)
 {
     return {x, y};
 }
 
+// V2...
+//
+
 struct V2
 {
     f32 x;
     f32 y;
-
-    V2 operator*(f32 t);
-    V2 operator/(f32 t);
-    V2 operator+(V2 b);
-    V2 operator-(V2 b);
-    void operator+=(V2 b);
 };
 
-inline V2 v2(f32 x, f32 y)
+constexpr V2 v2(f32 x, f32 y)
 {
     return {x, y};
 }
 
-inline V2 v2(f32 x)
+constexpr V2 v2(f32 x)
 {
     return {x, x};
 }
 
+constexpr V2 operator+(V2 a, V2 b) { return {a.x + b.x, a.y + b.y}; }
+constexpr V2 operator-(V2 a, V2 b) { return {a.x - b.x, a.y - b.y}; }
+constexpr V2 operator*(V2 a, V2 b) { return {a.x * b.x, a.y * b.y}; }
+constexpr V2 operator/(V2 a, V2 b) { return {a.x / b.x, a.y / b.y}; }
+constexpr V2 operator*(V2 a, f32 t) { return {a.x * t, a.y * t}; }
+constexpr V2 operator*(f32 t, V2 a) { return {a.x * t, a.y * t}; }
+constexpr V2 operator/(V2 a, f32 t) { return {a.x / t, a.y / t}; }
+constexpr V2 operator-(V2 a) { return {-a.x, -a.y}; }
+
+constexpr V2 &operator+=(V2 &a, V2 b) { a.x += b.x; a.y += b.y; return a; }
+constexpr V2 &operator-=(V2 &a, V2 b) { a.x -= b.x; a.y -= b.y; return a; }
+constexpr V2 &operator*=(V2 &a, f32 t) { a.x *= t; a.y *= t; return a; }
+
+constexpr f32 Dot(V2 a, V2 b)
+{
+    return a.x * b.x + a.y * b.y;
+}
+
+constexpr f32 LengthSq(V2 a)
+{
+    return Dot(a, a);
+}
+
+inline f32 Length(V2 a)
+{
+    return Sqrt(LengthSq(a));
+}
+
+constexpr V2 Lerp(V2 a, V2 b, f32 t)
+{
+    return a + (b - a) * t;
+}
+
+constexpr V2 Clamp(V2 a, V2 min, V2 max)
+{
+    return {Clamp(a.x, min.x, max.x), Clamp(a.y, min.y, max.y)};
+}
+
+inline V2 Norm(V2 a)
+{
+    f32 square_length = LengthSq(a);
+    if (square_length < 0.001)
+    {
+        return v2(0);
+    }
+
+    return a / Sqrt(square_length);
+}
+
+// V3...
+//
+
 struct V3
 {
     f32 x;
     f32 y;
     f32 z;
-
-    V3 operator/(f32 t);
-    V3 operator-(V3 b);
-    V3 operator+(V3 b);
-    void operator+=(V3 b);
 };
 
-inline V3 v3(f32 x, f32 y, f32 z)
+constexpr V3 v3(f32 x, f32 y, f32 z)
 {
     return {x, y, z};
 }
 
-inline V3 v3(f32 x)
+constexpr V3 v3(f32 x)
 {
     return {x, x, x};
 }
 
-inline f32 Dot(V3 a, V3 b)
+constexpr V3 v3(V2 xy, f32 z)
+{
+    return {xy.x, xy.y, z};
+}
+
+constexpr V3 operator+(V3 a, V3 b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+constexpr V3 operator-(V3 a, V3 b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+constexpr V3 operator*(V3 a, V3 b) { return {a.x * b.x, a.y * b.y, a.z * b.z}; }
+constexpr V3 operator/(V3 a, V3 b) { return {a.x / b.x, a.y / b.y, a.z / b.z}; }
+constexpr V3 operator*(V3 a, f32 t) { return {a.x * t, a.y * t, a.z * t}; }
+constexpr V3 operator*(f32 t, V3 a) { return {a.x * t, a.y * t, a.z * t}; }
+constexpr V3 operator/(V3 a, f32 t) { return {a.x / t, a.y / t, a.z / t}; }
+constexpr V3 operator-(V3 a) { return {-a.x, -a.y, -a.z}; }
+
+constexpr V3 &operator+=(V3 &a, V3 b) { a.x += b.x; a.y += b.y; a.z += b.z; return a; }
+constexpr V3 &operator-=(V3 &a, V3 b) { a.x -= b.x; a.y -= b.y; a.z -= b.z; return a; }
+constexpr V3 &operator*=(V3 &a, f32 t) { a.x *= t; a.y *= t; a.z *= t; return a; }
+
+constexpr f32 Dot(V3 a, V3 b)
 {
     return a.x * b.x + a.y * b.y + a.z * b.z;
 }
 
-inline V3 Cross(V3 a, V3 b)
+constexpr V3 Cross(V3 a, V3 b)
 {
-    V3 result;
-    result.x = a.y * b.z - a.z * b.y;
-    result.y = a.z * b.x - a.x * b.z;
-    result.z = a.x * b.y - a.y * b.x;
-    return result;
+    return {
+        a.y * b.z - a.z * b.y,
+        a.z * b.x - a.x * b.z,
+        a.x * b.y - a.y * b.x,
+    };
 }
 
-inline f32 Radians(f32 a)
+constexpr f32 LengthSq(V3 a)
 {
-    return a / 180 * PI;
+    return Dot(a, a);
 }
 
-V2 Norm(V2 a);
+inline f32 Length(V3 a)
+{
+    return Sqrt(LengthSq(a));
+}
+
+constexpr V3 Lerp(V3 a, V3 b, f32 t)
+{
+    return a + (b - a) * t;
+}
+
+constexpr V3 Clamp(V3 a, V3 min, V3 max)
+{
+    return {Clamp(a.x, min.x, max.x), Clamp(a.y, min.y, max.y), Clamp(a.z, min.z, max.z)};
+}
+
+inline V3 Norm(V3 a)
+{
+    return a / Length(a);
+}
 
-V3 Norm(V3 a);
+// V4...
+//
 
-struct Mat4
+struct V4
+{
+    f32 x;
+    f32 y;
+    f32 z;
+    f32 w;
+};
+
+constexpr V4 v4(f32 x, f32 y, f32 z, f32 w)
+{
+    return {x, y, z, w};
+}
+
+constexpr V4 v4(f32 x)
+{
+    return {x, x, x, x};
+}
+
+constexpr V4 v4(V3 xyz, f32 w)
+{
+    return {xyz.x, xyz.y, xyz.z, w};
+}
+
+constexpr V4 operator+(V4 a, V4 b) { return {a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w}; }
+constexpr V4 operator-(V4 a, V4 b) { return {a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w}; }
+constexpr V4 operator*(V4 a, V4 b) { return {a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w}; }
+constexpr V4 operator*(V4 a, f32 t) { return {a.x * t, a.y * t, a.z * t, a.w * t}; }
+constexpr V4 operator*(f32 t, V4 a) { return {a.x * t, a.y * t, a.z * t, a.w * t}; }
+constexpr V4 operator/(V4 a, f32 t) { return {a.x / t, a.y / t, a.z / t, a.w / t}; }
+constexpr V4 operator-(V4 a) { return {-a.x, -a.y, -a.z, -a.w}; }
+
+constexpr V4 &operator+=(V4 &a, V4 b) { a.x += b.x; a.y += b.y; a.z += b.z; a.w += b.w; return a; }
+
+constexpr f32 Dot(V4 a, V4 b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+constexpr f32 LengthSq(V4 a)
+{
+    return Dot(a, a);
+}
+
+constexpr V4 Lerp(V4 a, V4 b, f32 t)
+{
+    return a + (b - a) * t;
+}
+
+// Quat...
+//
+
+struct Quat
+{
+    f32 x;
+    f32 y;
+    f32 z;
+    f32 w;
+};
+
+constexpr Quat quat(f32 x, f32 y, f32 z, f32 w)
+{
+    return {x, y, z, w};
+}
+
+constexpr Quat QuatIdentity()
+{
+    return {0, 0, 0, 1};
+}
+
+// axis must be normalized
+inline Quat QuatAxisAngle(V3 axis, f32 angle)
+{
+    f32 s = sinf(angle / 2);
+    return {axis.x * s, axis.y * s, axis.z * s, cosf(angle / 2)};
+}
+
+// Applies b first, then a
+constexpr Quat operator*(Quat a, Quat b)
+{
+    return {
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+    };
+}
+
+constexpr f32 Dot(Quat a, Quat b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+inline Quat Norm(Quat q)
+{
+    f32 inv_length = 1 / Sqrt(Dot(q, q));
+    return {q.x * inv_length, q.y * inv_length, q.z * inv_length, q.w * inv_length};
+}
+
+// Normalized lerp along the shorter arc
+inline Quat Nlerp(Quat a, Quat b, f32 t)
+{
+    f32 sign = Dot(a, b) < 0 ? -1 : 1;
+    return Norm({
+        Lerp(a.x, b.x * sign, t),
+        Lerp(a.y, b.y * sign, t),
+        Lerp(a.z, b.z * sign, t),
+        Lerp(a.w, b.w * sign, t),
+    });
+}
+
+constexpr V3 Rotate(Quat q, V3 v)
+{
+    V3 u = v3(q.x, q.y, q.z);
+    V3 t = Cross(u, v) * 2;
+    return v + t * q.w + Cross(u, t);
+}
+
+// SIMD helpers...
+//
+
+#ifdef MATH_SSE
+
+inline __m128 MulAdd(__m128 a, __m128 b, __m128 c)
+{
+#ifdef MATH_FMA
+    return _mm_fmadd_ps(a, b, c);
+#else
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+#ifdef MATH_AVX
+inline __m256 MulAdd(__m256 a, __m256 b, __m256 c)
+{
+#ifdef MATH_FMA
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+#endif
+
+#endif
+
+// Mat4...
+//
+
+// Column major, v[row + 4 * column]
+struct alignas(16) Mat4
 {
     f32 v[16];
-    
-    Mat4 operator*(Mat4 b);
 };
 
-Mat4 Ortho(f32 l, f32 r, f32 b, f32 t, f32 n, f32 f);
-Mat4 perspective(f32 fov, f32 aspect, f32 near_plane, f32 far_plane);
-Mat4 LookAt(V3 eye, V3 target, V3 up);
+constexpr Mat4 Identity()
+{
+    return {
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1,
+    };
+}
+
+// Translation * rotation * scale
+constexpr Mat4 TRS(V3 t, Quat r, V3 s)
+{
+    f32 xx = r.x * r.x, yy = r.y * r.y, zz = r.z * r.z;
+    f32 xy = r.x * r.y, xz = r.x * r.z, yz = r.y * r.z;
+    f32 wx = r.w * r.x, wy = r.w * r.y, wz = r.w * r.z;
+
+    return {
+        (1 - 2 * (yy + zz)) * s.x, 2 * (xy + wz) * s.x, 2 * (xz - wy) * s.x, 0,
+        2 * (xy - wz) * s.y, (1 - 2 * (xx + zz)) * s.y, 2 * (yz + wx) * s.y, 0,
+        2 * (xz + wy) * s.z, 2 * (yz - wx) * s.z, (1 - 2 * (xx + yy)) * s.z, 0,
+        t.x, t.y, t.z, 1,
+    };
+}
+
+constexpr Mat4 Ortho(f32 l, f32 r, f32 b, f32 t, f32 n, f32 f)
+{
+    return {
+        2/(r-l), 0, 0, 0,
+        0, 2/(t-b), 0, 0,
+        0, 0, -2/(f-n), 0,
+        -(r+l)/(r-l), -(t+b)/(t-b), -(f+n)/(f-n), 1,
+    };
+}
+
+// tan() is not constexpr, so the compile time version takes tan(fov / 2) directly
+constexpr Mat4 PerspectiveTan(f32 tan_half_fov, f32 aspect, f32 near_plane, f32 far_plane)
+{
+    return {
+        1.0f / (tan_half_fov * aspect), 0, 0, 0,
+        0, 1.0f / tan_half_fov, 0, 0,
+        0, 0, -(far_plane + near_plane) / (far_plane - near_plane), -1,
+        0, 0, -(2 * near_plane * far_plane) / (far_plane - near_plane), 0,
+    };
+}
+
+inline Mat4 perspective(f32 fov, f32 aspect, f32 near_plane, f32 far_plane)
+{
+    return PerspectiveTan(tanf(fov / 2), aspect, near_plane, far_plane);
+}
+
+inline Mat4 LookAt(V3 eye, V3 target, V3 up)
+{
+    V3 f = Norm(target - eye);
+    V3 s = Norm(Cross(f, up));
+    V3 u = Cross(s, f);
+
+    return {
+        s.x, u.x, -f.x, 0,
+        s.y, u.y, -f.y, 0,
+        s.z, u.z, -f.z, 0,
+        -Dot(s, eye), -Dot(u, eye), Dot(f, eye), 1,
+    };
+}
+
+inline Mat4 operator*(Mat4 a, Mat4 b)
+{
+    Mat4 res;
+
+#if defined(MATH_AVX)
+    __m256 a0 = _mm256_broadcast_ps((__m128 *) (a.v + 0));
+    __m256 a1 = _mm256_broadcast_ps((__m128 *) (a.v + 4));
+    __m256 a2 = _mm256_broadcast_ps((__m128 *) (a.v + 8));
+    __m256 a3 = _mm256_broadcast_ps((__m128 *) (a.v + 12));
 
-bool AABBCollision(V2 bl0, V2 tr0, V2 bl1, V2 tr1);
+    // Two result columns per iteration
+    for (u32 j = 0; j < 4; j += 2) {
+        __m256 bj = _mm256_loadu_ps(b.v + 4 * j);
+        __m256 acc = _mm256_mul_ps(a0, _mm256_shuffle_ps(bj, bj, 0x00));
+        acc = MulAdd(a1, _mm256_shuffle_ps(bj, bj, 0x55), acc);
+        acc = MulAdd(a2, _mm256_shuffle_ps(bj, bj, 0xAA), acc);
+        acc = MulAdd(a3, _mm256_shuffle_ps(bj, bj, 0xFF), acc);
+        _mm256_storeu_ps(res.v + 4 * j, acc);
+    }
+#elif defined(MATH_SSE)
+    __m128 a0 = _mm_load_ps(a.v + 0);
+    __m128 a1 = _mm_load_ps(a.v + 4);
+    __m128 a2 = _mm_load_ps(a.v + 8);
+    __m128 a3 = _mm_load_ps(a.v + 12);
+
+    for (u32 j = 0; j < 4; ++j) {
+        __m128 bj = _mm_load_ps(b.v + 4 * j);
+        __m128 acc = _mm_mul_ps(a0, _mm_shuffle_ps(bj, bj, 0x00));
+        acc = MulAdd(a1, _mm_shuffle_ps(bj, bj, 0x55), acc);
+        acc = MulAdd(a2, _mm_shuffle_ps(bj, bj, 0xAA), acc);
+        acc = MulAdd(a3, _mm_shuffle_ps(bj, bj, 0xFF), acc);
+        _mm_store_ps(res.v + 4 * j, acc);
+    }
+#else
+    for (u32 i = 0; i < 4; ++i) {
+        for (u32 j = 0; j < 4; ++j) {
+            float acc = 0;
+            for (u32 k = 0; k < 4; ++k) {
+                acc += a.v[i + 4 * k] * b.v[4 * j + k];
+            }
+            res.v[i + 4 * j] = acc;
+        }
+    }
+#endif
+
+    return res;
+}
+
+inline Mat4 Transpose(Mat4 m)
+{
+    Mat4 res;
+
+#ifdef MATH_SSE
+    __m128 c0 = _mm_load_ps(m.v + 0);
+    __m128 c1 = _mm_load_ps(m.v + 4);
+    __m128 c2 = _mm_load_ps(m.v + 8);
+    __m128 c3 = _mm_load_ps(m.v + 12);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _mm_store_ps(res.v + 0, c0);
+    _mm_store_ps(res.v + 4, c1);
+    _mm_store_ps(res.v + 8, c2);
+    _mm_store_ps(res.v + 12, c3);
+#else
+    for (u32 i = 0; i < 4; ++i) {
+        for (u32 j = 0; j < 4; ++j) {
+            res.v[i + 4 * j] = m.v[j + 4 * i];
+        }
+    }
+#endif
+
+    return res;
+}
+
+constexpr V3 TransformPoint(Mat4 m, V3 p)
+{
+    return {
+        m.v[0] * p.x + m.v[4] * p.y + m.v[8] * p.z + m.v[12],
+        m.v[1] * p.x + m.v[5] * p.y + m.v[9] * p.z + m.v[13],
+        m.v[2] * p.x + m.v[6] * p.y + m.v[10] * p.z + m.v[14],
+    };
+}
+
+constexpr V3 TransformVector(Mat4 m, V3 v)
+{
+    return {
+        m.v[0] * v.x + m.v[4] * v.y + m.v[8] * v.z,
+        m.v[1] * v.x + m.v[5] * v.y + m.v[9] * v.z,
+        m.v[2] * v.x + m.v[6] * v.y + m.v[10] * v.z,
+    };
+}
+
+constexpr V4 Transform(Mat4 m, V4 p)
+{
+    return {
+        m.v[0] * p.x + m.v[4] * p.y + m.v[8] * p.z + m.v[12] * p.w,
+        m.v[1] * p.x + m.v[5] * p.y + m.v[9] * p.z + m.v[13] * p.w,
+        m.v[2] * p.x + m.v[6] * p.y + m.v[10] * p.z + m.v[14] * p.w,
+        m.v[3] * p.x + m.v[7] * p.y + m.v[11] * p.z + m.v[15] * p.w,
+    };
+}
+
+// The heavier matrix routines stay out of line in game_math.cpp
+Mat4 Inverse(Mat4 m);
+// Only valid when the last row is (0, 0, 0, 1), i.e. no projection
+Mat4 AffineInverse(Mat4 m);
+// Inverse transpose of the upper 3x3, translation cleared
+Mat4 NormalMatrix(Mat4 m);
+
+// in and out may alias
+void TransformPoints(Mat4 m, V3 *in, V3 *out, u32 count);
+void TransformVectors(Mat4 m, V3 *in, V3 *out, u32 count);
+
+constexpr bool AABBCollision(V2 bl0, V2 tr0, V2 bl1, V2 tr1)
+{
+    return  bl0.x <= tr1.x &&
+            tr0.x >= bl1.x &&
+            bl0.y <= tr1.y &&
+            tr0.y >= bl1.y;
+}
@@ -0,0 +1,165 @@
+#include "level.h"
+
+#include <assert.h>
+#include <string.h>
+
+inline TileType TileFromColor(u8 *pixel)
+{
+    if (pixel[3] < 128)
+    {
+        return Tile_Empty;
+    }
+
+    u32 key = (pixel[0] > 127) << 2 | (pixel[1] > 127) << 1 | (pixel[2] > 127);
+    switch (key)
+    {
+        case 0: return Tile_Wall;
+        case 4: return Tile_EnemySpawn;
+        case 1: return Tile_PlayerSpawn;
+        default: return Tile_Floor;
+    }
+}
+
+static bool ApplyLevel(World *world, LevelFileHeader *header, LevelFileChunk *chunks, Level *level)
+{
+    for (u32 i = 0; i < header->chunk_count; ++i)
+    {
+        LevelFileChunk *source = chunks + i;
+        Chunk *chunk = GetOrCreateChunk(world, source->x, source->y);
+        assert(!(chunk->flags & ChunkFlag_Loading));
+
+        if (!chunk->data)
+        {
+            chunk->data = AllocateChunkData(world);
+            if (!chunk->data)
+            {
+                return false;
+            }
+        }
+
+        ChunkData *data = chunk->data;
+        chunk->flags = ChunkFlag_Pinned | ChunkFlag_HasTiles;
+        chunk->enemy_count = 0;
+        chunk->tower_count = 0;
+        data->enemy_hurt = 0;
+        memcpy(data->tiles, source->tiles, sizeof(data->tiles));
+        TouchTiles(world, chunk);
+
+        // One enemy in the middle of every spawn tile
+        for (u32 t = 0; t < lengthof(data->tiles); ++t)
+        {
+            if (data->tiles[t] != Tile_EnemySpawn || chunk->enemy_count == CHUNK_ENEMY_CAPACITY)
+            {
+                continue;
+            }
+
+            u32 e = chunk->enemy_count++;
+            data->enemy_x[e] = (source->x * CHUNK_SIZE + t % CHUNK_SIZE + 0.5) * TILE_SIZE;
+            data->enemy_y[e] = (source->y * CHUNK_SIZE + t / CHUNK_SIZE + 0.5) * TILE_SIZE;
+            data->enemy_vel_x[e] = 0;
+            data->enemy_vel_y[e] = 0;
+            data->enemy_hp[e] = 10;
+            data->enemy_damage[e] = 0;
+            data->enemy_state[e] = EnemyState_Wander;
+        }
+    }
+
+    level->width = header->width;
+    level->height = header->height;
+    level->player_tile_x = header->player_tile_x;
+    level->player_tile_y = header->player_tile_y;
+    return true;
+}
+
+static bool LoadLevelCache(World *world, PlatformApi *platform, const char *cache_path, u64 png_write_time, Level *level)
+{
+    MappedFile file = platform->MapFile(cache_path);
+    if (!file.memory)
+    {
+        return false;
+    }
+
+    LevelFileHeader *header = (LevelFileHeader *) file.memory;
+    bool valid = file.size >= sizeof(LevelFileHeader) &&
+                 header->magic == LEVEL_FILE_MAGIC &&
+                 header->version == LEVEL_FILE_VERSION &&
+                 file.size == sizeof(LevelFileHeader) + header->chunk_count * sizeof(LevelFileChunk) &&
+                 (!png_write_time || header->source_write_time == png_write_time);
+
+    bool result = valid && ApplyLevel(world, header, (LevelFileChunk *) (header + 1), level);
+
+    platform->UnmapFile(&file);
+    return result;
+}
+
+static bool BuildLevelCache(World *world, PlatformApi *platform, const char *png_path, const char *cache_path,
+                            u64 png_write_time, Level *level)
+{
+    MappedFile png = platform->MapFile(png_path);
+    if (!png.memory)
+    {
+        return false;
+    }
+
+    i32 width, height, channels;
+    u8 *pixels = stbi_load_from_memory((u8 *) png.memory, (i32) png.size, &width, &height, &channels, 4);
+    platform->UnmapFile(&png);
+    if (!pixels)
+    {
+        return false;
+    }
+
+    u32 chunks_x = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    u32 chunks_y = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    // Header and chunks laid out exactly as the file
+    TempMemory temp = ScratchAllocate();
+    u64 file_size = sizeof(LevelFileHeader) + chunks_x * chunks_y * sizeof(LevelFileChunk);
+    LevelFileHeader *header = (LevelFileHeader *) PushBytesZero(temp.arena, file_size);
+    LevelFileChunk *chunks = (LevelFileChunk *) (header + 1);
+
+    header->magic = LEVEL_FILE_MAGIC;
+    header->version = LEVEL_FILE_VERSION;
+    header->source_write_time = png_write_time;
+    header->width = width;
+    header->height = height;
+    header->chunk_count = chunks_x * chunks_y;
+
+    for (u32 i = 0; i < header->chunk_count; ++i)
+    {
+        chunks[i].x = i % chunks_x;
+        chunks[i].y = i / chunks_x;
+    }
+
+    for (i32 y = 0; y < height; ++y)
+    {
+        for (i32 x = 0; x < width; ++x)
+        {
+            TileType tile = TileFromColor(pixels + (y * width + x) * 4);
+            LevelFileChunk *chunk = chunks + (y / CHUNK_SIZE) * chunks_x + x / CHUNK_SIZE;
+            chunk->tiles[(y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE] = tile;
+
+            if (tile == Tile_PlayerSpawn)
+            {
+                header->player_tile_x = x;
+                header->player_tile_y = y;
+            }
+        }
+    }
+
+    stbi_image_free(pixels);
+
+    // A failed write only costs the next load a png decode
+    platform->WriteFile(cache_path, header, file_size);
+
+    bool result = ApplyLevel(world, header, chunks, level);
+    EndTempRegion(temp);
+    return result;
+}
+
+bool LoadLevel(World *world, PlatformApi *platform, const char *png_path, const char *cache_path, Level *level)
+{
+    u64 png_write_time = platform->GetFileWriteTime(png_path);
+    return LoadLevelCache(world, platform, cache_path, png_write_time, level) ||
+           BuildLevelCache(world, platform, png_path, cache_path, png_write_time, level);
+}
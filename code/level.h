@@ -0,0 +1,50 @@
+#pragma once
+
+#include "defines.h"
+#include "memory.h"
+#include "platform.h"
+#include "world.h"
+#include "stb_image.h"
+
+// Levels are authored as pngs, one pixel per tile: black walls, white floor, red
+// enemy spawns, blue the player spawn, transparent outside the level. The first
+// load decodes the png and writes a .lvl cache of ready made chunk tile grids,
+// later loads map the cache and copy the grids straight into the world.
+
+#define LEVEL_FILE_MAGIC 0x314c564c // "LVL1"
+#define LEVEL_FILE_VERSION 1
+
+struct LevelFileHeader
+{
+    u32 magic;
+    u32 version;
+    // Of the png the cache was built from, a mismatch rebuilds the cache
+    u64 source_write_time;
+
+    u32 width;
+    u32 height;
+    i32 player_tile_x;
+    i32 player_tile_y;
+
+    u32 chunk_count;
+};
+
+// Follows the header, chunk_count of them
+struct LevelFileChunk
+{
+    i32 x;
+    i32 y;
+    u8 tiles[CHUNK_SIZE * CHUNK_SIZE];
+};
+
+struct Level
+{
+    u32 width;
+    u32 height;
+    i32 player_tile_x;
+    i32 player_tile_y;
+};
+
+// Loads the level into its chunks, replacing whatever they held, and pins them.
+// Returns false when neither the cache nor the png could be read.
+bool LoadLevel(World *world, PlatformApi *platform, const char *png_path, const char *cache_path, Level *level);
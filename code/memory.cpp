@@ -24,9 +24,16 @@ TempMemory ScratchAllocate()
     return BeginTempRegion(&scratch);
 }
 
+// Aligns the address, not the offset, the arena memory itself may be less aligned
+inline u64 AlignedOffset(Arena *arena, u64 align)
+{
+    u64 base = (u64) arena->memory;
+    return ((base + arena->offset + align - 1) & ~(align - 1)) - base;
+}
+
 u8 *AllocateBytes(Arena *arena, u64 size, u64 align)
 {
-    u64 start = (arena->offset + align - 1) & ~(align - 1);
+    u64 start = AlignedOffset(arena, align);
     u64 end = start + size;
     assert(start + size <= arena->capacity);
     arena->offset = end;
@@ -35,7 +42,7 @@ u8 *AllocateBytes(Arena *arena, u64 size, u64 align)
 
 u8 *AllocateBytesZero(Arena *arena, u64 size, u64 align)
 {
-    u64 start = (arena->offset + align - 1) & ~(align - 1);
+    u64 start = AlignedOffset(arena, align);
     u64 end = start + size;
     assert(start + size <= arena->capacity);
     arena->offset = end;
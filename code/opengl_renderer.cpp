@@ -5,20 +5,134 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stddef.h>
+#include <string.h>
 
 #include "defines.h"
 #include "memory.h"
 #include "platform.h"
+#include "profiler.h"
+#include "culling.h"
+#include "radix_sort.h"
+
+#define MAX_SHADER_STAGES 2
+
+struct ShaderStage
+{
+    GLenum type;
+    const char *file;
+};
+
+// Feature bits of shader/world.vert, each one becomes a #define of the same
+// name. Variants only pay for the features a draw needs instead of branching
+// on them in one shader.
+enum ShaderFeature
+{
+    // Transform and tint from the visible instance buffer
+    ShaderFeature_Instanced = 1 << 0,
+    // PackedVertex input, dequantized by the instance bounds
+    ShaderFeature_Quantized = 1 << 1,
+    // Octahedral normals lit by the fixed light
+    ShaderFeature_Lit = 1 << 2,
+
+    ShaderFeature_VariantCount = 1 << 3,
+};
+
+const char *shader_feature_names[] = {"INSTANCED", "QUANTIZED", "LIT"};
 
 struct Shader
 {
     u32 id;
+    u32 features;
+    // Dense, for the 6 bit shader field of RenderSortKey. Program names are
+    // sparse and change on every reload.
+    u32 sort_index;
+
+    // Hot reload. A changed source is compiled into pending_program while id
+    // keeps drawing, and id is only swapped once the new program has linked.
+    ShaderStage stages[MAX_SHADER_STAGES];
+    u32 stage_count;
+    u64 write_time;
+    u32 pending_program;
+    u32 pending_stages[MAX_SHADER_STAGES];
+    u64 pending_hash;
+};
+
+// Variants are compiled the first time a draw asks for them
+struct ShaderPermutations
+{
+    ShaderStage stages[MAX_SHADER_STAGES];
+    u32 stage_count;
+    Shader variants[ShaderFeature_VariantCount];
+};
+
+ShaderPermutations world_shaders;
+Shader tilemap_shader;
+Shader level_cache_shader;
+
+Shader quad_shader;
+Shader cull_shader;
+
+u32 quad_gpu_buffer;
+u32 quad_vao;
+
+// Per frame quads stream through a persistently mapped ring of regions. The
+// game writes one region while the gpu may still be reading the others, and a
+// fence per region keeps a region from being reused while it is in flight.
+#define FRAME_REGION_COUNT 3
+#define FRAME_REGION_QUADS 4096
+
+QuadInstance *mapped_quads;
+GLsync region_fences[FRAME_REGION_COUNT];
+u32 current_region;
+
+// Per instance data of the instanced shader/world.vert, std430 layout. Lives in the same
+// fenced regions as the quads.
+struct MeshInstance
+{
+    Mat4 transform;
+    // Dequantization of the mesh's PackedVertex positions, w unused
+    V4 bounds_min;
+    V4 bounds_extent;
+    u32 tint;
+    // Indirect draw of the instance's mesh
+    u32 draw;
+    u32 pad[2];
+};
+
+#define FRAME_REGION_MESH_INSTANCES 4096
+
+// The cpu writes every submitted instance, shader/cull_instances.comp copies
+// the visible ones into the gpu only buffer that shader/world.vert reads
+u32 mesh_instance_buffer;
+u32 visible_instance_buffer;
+MeshInstance *mapped_mesh_instances;
+u32 mesh_instance_count;
+
+// Buffer bindings of shader/cull_instances.comp and shader/world.vert
+#define VISIBLE_INSTANCE_BINDING 2
+#define MESH_INSTANCE_BINDING 3
+#define INDIRECT_DRAW_BINDING 4
+
+// Uniforms of shader/cull_instances.comp
+#define CULL_FIRST_INSTANCE_LOCATION 0
+#define CULL_INSTANCE_COUNT_LOCATION 1
+#define CULL_GROUP_SIZE 64
+
+// Layout glMultiDrawElementsIndirect reads
+struct DrawElementsIndirectCommand
+{
+    u32 count;
+    u32 instance_count;
+    u32 first_index;
+    i32 base_vertex;
+    u32 base_instance;
 };
 
-Shader default_shader;
+#define FRAME_REGION_DRAWS 1024
 
-u32 vertex_gpu_buffer;
-u32 vertex_vao;
+u32 indirect_buffer;
+DrawElementsIndirectCommand *mapped_draws;
+u32 draw_count;
 
 u32 uniform_buffer;
 
@@ -30,104 +144,567 @@ struct UniformBuffer
 
 UniformBuffer uniforms;
 
+// layout (location = 0) uniform mat4 model in the shaders
+#define MODEL_UNIFORM_LOCATION 0
+
+// Every static mesh is sub-allocated from one vertex and one index buffer,
+// so all of them share a vao and draw with a single multi draw indirect
+#define MESH_BUFFER_VERTICES (512 * 1024)
+#define MESH_BUFFER_INDICES (2 * 1024 * 1024)
+
+u32 mesh_vao;
+u32 mesh_vertex_buffer;
+u32 mesh_index_buffer;
+u32 mesh_vertex_count;
+u32 mesh_index_count;
+u32 mesh_count;
+
+// Static level geometry. Every resident level chunk owns a slot with a fixed
+// range of the level buffer and a layer of the level texture. Only the
+// representation of the current LevelRenderMode is refreshed, and only when
+// the chunk's tile version changes.
+
+// Worst case for greedy meshing is a checkerboard, one quad per tile
+#define LEVEL_SLOT_VERTICES (CHUNK_SIZE * CHUNK_SIZE * 6)
+
+struct LevelSlot
+{
+    bool in_use;
+    i32 x;
+    i32 y;
+    u64 last_frame;
+
+    u32 mesh_version;
+    u32 vertex_count;
+
+    // Mirror of the slot's texture layer, so an edit only uploads the texels that changed
+    u32 texture_version;
+    u8 tiles[CHUNK_SIZE * CHUNK_SIZE];
+};
+
+LevelSlot level_slots[MAX_LEVEL_CHUNKS];
+u32 level_gpu_buffer;
+u32 level_vao;
+u32 level_texture;
+u64 frame_index;
+
+// Uniform locations of shader/tilemap.*
+#define TILEMAP_PALETTE_LOCATION 1
+#define TILEMAP_CHUNKS_LOCATION 17
+
+// Orthographic level cache. The level is rendered into a texture covering the
+// view plus LEVEL_CACHE_PADDING world units on every side, and only rendered
+// again when the view leaves that region or the level changes. Every other
+// frame the level is a single textured quad.
+#define LEVEL_CACHE_PADDING 256
+
+struct LevelCache
+{
+    u32 framebuffer;
+    u32 texture;
+    i32 width;
+    i32 height;
+
+    bool valid;
+    LevelRenderMode mode;
+    V2 min;
+    V2 max;
+};
+
+LevelCache level_cache;
+
+// layout (location = 1) uniform vec4 rect in shader/level_cache.vert
+#define LEVEL_CACHE_RECT_LOCATION 1
+
 // Resources
 //
 
-Shader LoadShader(const char* vertex_file, const char* frag_file)
+// Linked programs are cached in shader_cache/ as glGetProgramBinary output. The
+// file name hashes every stage's source together with the driver strings, so an
+// edit or a driver update just misses the cache and compiles from source again.
+#define SHADER_CACHE_MAGIC 0x4e424853 // "SHBN"
+#define SHADER_CACHE_VERSION 1
+
+struct ShaderCacheHeader
+{
+    u32 magic;
+    u32 version;
+    u32 binary_format;
+    u32 binary_size;
+};
+
+// GL_KHR_parallel_shader_compile, which our glad was generated without. With it
+// compiles and links run on driver threads and only block when their status is
+// queried, GL_COMPLETION_STATUS_KHR says when that would no longer block.
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+bool parallel_shader_compile;
+
+// Watched shaders hand out the sort indices, so no more than the sort key can tell apart
+#define MAX_WATCHED_SHADERS 64
+
+Shader *watched_shaders[MAX_WATCHED_SHADERS];
+u32 watched_shader_count;
+
+PlatformApi *renderer_platform;
+
+// FNV-1a
+u64 HashBytes(u64 hash, const void *data, u64 size)
+{
+    u8 *bytes = (u8 *) data;
+    for (u64 i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+u64 HashString(u64 hash, const char *string)
+{
+    return HashBytes(hash, string, strlen(string));
+}
+
+bool LoadProgramBinary(u32 program, const char *cache_file)
+{
+    MappedFile file = renderer_platform->MapFile(cache_file);
+    if (!file.memory)
+    {
+        return false;
+    }
+
+    ShaderCacheHeader *header = (ShaderCacheHeader *) file.memory;
+    bool valid = file.size >= sizeof(ShaderCacheHeader) &&
+                 header->magic == SHADER_CACHE_MAGIC &&
+                 header->version == SHADER_CACHE_VERSION &&
+                 file.size == sizeof(ShaderCacheHeader) + header->binary_size;
+
+    i32 status = 0;
+    if (valid)
+    {
+        // Drivers may reject a binary for any reason, the link status says whether it took
+        glProgramBinary(program, header->binary_format, header + 1, header->binary_size);
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+    }
+
+    renderer_platform->UnmapFile(&file);
+    return status;
+}
+
+void SaveProgramBinary(u32 program, const char *cache_file, Arena *arena)
+{
+    i32 binary_size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_size);
+    if (binary_size <= 0)
+    {
+        return;
+    }
+
+    u64 file_size = sizeof(ShaderCacheHeader) + binary_size;
+    ShaderCacheHeader *header = (ShaderCacheHeader *) PushBytesZero(arena, file_size);
+    header->magic = SHADER_CACHE_MAGIC;
+    header->version = SHADER_CACHE_VERSION;
+    header->binary_size = binary_size;
+
+    GLenum binary_format;
+    glGetProgramBinary(program, binary_size, NULL, &binary_format, header + 1);
+    header->binary_format = binary_format;
+
+    // A failed write only costs the next launch a compile
+    renderer_platform->WriteFile(cache_file, header, file_size);
+}
+
+inline void ShaderCacheFile(char *buffer, u32 size, u64 hash)
+{
+    snprintf(buffer, size, "shader_cache/%016llx.bin", (unsigned long long) hash);
+}
+
+// Reads every stage and the hash that names the program's cache file. Fails
+// instead of asserting, a file being saved may be locked or empty for a moment.
+bool ReadShaderSources(Shader *shader, u8 **code, u64 *hash_out, Arena *arena)
+{
+    u64 hash = 0xcbf29ce484222325ull;
+    hash = HashString(hash, (char *) glGetString(GL_VENDOR));
+    hash = HashString(hash, (char *) glGetString(GL_RENDERER));
+    hash = HashString(hash, (char *) glGetString(GL_VERSION));
+
+    hash = HashBytes(hash, &shader->features, sizeof(shader->features));
+
+    for (u32 i = 0; i < shader->stage_count; ++i)
+    {
+        MappedFile file = renderer_platform->MapFile(shader->stages[i].file);
+        if (!file.memory || !file.size)
+        {
+            return false;
+        }
+
+        code[i] = PushBytes(arena, file.size + 1);
+        memcpy(code[i], file.memory, file.size);
+        code[i][file.size] = 0;
+        renderer_platform->UnmapFile(&file);
+
+        // Nothing past the #version line yet, the defines would have nowhere to go
+        if (!strchr((char *) code[i], '\n'))
+        {
+            return false;
+        }
+
+        hash = HashBytes(hash, &shader->stages[i].type, sizeof(GLenum));
+        hash = HashString(hash, (char *) code[i]);
+    }
+
+    *hash_out = hash;
+    return true;
+}
+
+// 0 while any stage is missing, editors may delete and rewrite on save
+u64 ShaderWriteTime(Shader *shader)
+{
+    u64 latest = 0;
+    for (u32 i = 0; i < shader->stage_count; ++i)
+    {
+        u64 write_time = renderer_platform->GetFileWriteTime(shader->stages[i].file);
+        if (!write_time)
+        {
+            return 0;
+        }
+        if (write_time > latest)
+        {
+            latest = write_time;
+        }
+    }
+    return latest;
+}
+
+// The defines have to go after the #version line, which must come first.
+// #line keeps error messages pointing at the lines of the file.
+void ShaderFeatureDefines(u32 features, char *buffer, u32 size)
+{
+    u32 length = 0;
+    for (u32 i = 0; i < lengthof(shader_feature_names); ++i)
+    {
+        if (features & (1 << i))
+        {
+            length += snprintf(buffer + length, size - length, "#define %s 1\n", shader_feature_names[i]);
+        }
+    }
+    snprintf(buffer + length, size - length, "#line 2\n");
+}
+
+// Issues the compiles and the link without asking for their status, which is
+// what would block on a parallel compiling driver
+u32 BeginCompileProgram(Shader *shader, u8 **code, u32 *stage_ids)
+{
+    char defines[256];
+    ShaderFeatureDefines(shader->features, defines, sizeof(defines));
+
+    u32 program = glCreateProgram();
+    for (u32 i = 0; i < shader->stage_count; ++i)
+    {
+        // Split after the #version line, ReadShaderSources made sure there is one
+        char *source = (char *) code[i];
+        char *newline = strchr(source, '\n');
+
+        const char *strings[] = {source, defines, newline + 1};
+        i32 lengths[] = {(i32) (newline + 1 - source), -1, -1};
+
+        stage_ids[i] = glCreateShader(shader->stages[i].type);
+        glShaderSource(stage_ids[i], lengthof(strings), strings, lengths);
+        glCompileShader(stage_ids[i]);
+        glAttachShader(program, stage_ids[i]);
+    }
+
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+    return program;
+}
+
+// Prints the compile and link errors, if any, and frees the stages
+bool EndCompileProgram(Shader *shader, u32 program, u32 *stage_ids)
 {
     char info_log[512];
     i32 status;
 
-    TempMemory temp_region = ScratchAllocate();
+    for (u32 i = 0; i < shader->stage_count; ++i)
+    {
+        glGetShaderiv(stage_ids[i], GL_COMPILE_STATUS, &status);
+        if (!status) 
+        {
+            glGetShaderInfoLog(stage_ids[i], 512, NULL, info_log);
+            printf("Error compiling shader (%s): %s", shader->stages[i].file, info_log);
+        }
+    }
 
-    u8 *vertex_code = ReadFile(vertex_file, temp_region.arena).memory;
-    assert(vertex_code);
-    u32 vertex_prog = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_prog, 1, (char **)  &vertex_code, NULL);
-    glCompileShader(vertex_prog);
-    glGetShaderiv(vertex_prog, GL_COMPILE_STATUS, &status);
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
     if (!status) 
     {
-        glGetShaderInfoLog(vertex_prog, 512, NULL, info_log);
-        printf("Error compiling vertex shader (%s): %s", vertex_file, info_log);
-        assert(0);
+        glGetProgramInfoLog(program, 512, NULL, info_log);
+        printf("Error linking shader (%s): %s", shader->stages[0].file, info_log);
     }
 
-    u8 *fragment_code = ReadFile(frag_file, temp_region.arena).memory;
-    assert(fragment_code);
-    u32 frag_prog = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(frag_prog, 1, (char **) &fragment_code, NULL);
-    glCompileShader(frag_prog);
-    glGetShaderiv(frag_prog, GL_COMPILE_STATUS, &status);
-    if (!status) 
+    for (u32 i = 0; i < shader->stage_count; ++i)
     {
-        glGetShaderInfoLog(frag_prog, 512, NULL, info_log);
-        printf("Error compiling fragment shader (%s): %s", frag_file, info_log);
-        assert(0);
+        glDetachShader(program, stage_ids[i]);
+        glDeleteShader(stage_ids[i]);
     }
 
-    Shader shader;
-    shader.id = glCreateProgram();
-    glAttachShader(shader.id, vertex_prog);
-    glAttachShader(shader.id, frag_prog);
-    glLinkProgram(shader.id);
-    glGetProgramiv(shader.id, GL_LINK_STATUS, &status);
+    return status;
+}
 
-    if (!status) 
+// On failure shader->id stays 0. write_time is left at the sources that failed
+// to compile, or 0 when they could not be read, so callers can tell when to retry.
+bool LoadProgram(Shader *shader, ShaderStage *stages, u32 stage_count, u32 features)
+{
+    assert(stage_count <= MAX_SHADER_STAGES);
+    assert(watched_shader_count < MAX_WATCHED_SHADERS);
+
+    *shader = {};
+    memcpy(shader->stages, stages, sizeof(ShaderStage) * stage_count);
+    shader->stage_count = stage_count;
+    shader->features = features;
+    shader->write_time = ShaderWriteTime(shader);
+
+    TempMemory temp_region = ScratchAllocate();
+
+    u8 *code[MAX_SHADER_STAGES];
+    u64 hash;
+    if (!ReadShaderSources(shader, code, &hash, temp_region.arena))
     {
-        glGetProgramInfoLog(shader.id, 512, NULL, info_log);
-        printf("Error linking shader: %s", info_log);
-        assert(0);
+        shader->write_time = 0;
+        EndTempRegion(temp_region);
+        return false;
     }
 
-    glDeleteShader(vertex_prog);
-    glDeleteShader(frag_prog);
+    char cache_file[64];
+    ShaderCacheFile(cache_file, sizeof(cache_file), hash);
+
+    shader->id = glCreateProgram();
+    if (!LoadProgramBinary(shader->id, cache_file))
+    {
+        glDeleteProgram(shader->id);
+
+        u32 stage_ids[MAX_SHADER_STAGES];
+        shader->id = BeginCompileProgram(shader, code, stage_ids);
+        if (!EndCompileProgram(shader, shader->id, stage_ids))
+        {
+            glDeleteProgram(shader->id);
+            shader->id = 0;
+            EndTempRegion(temp_region);
+            return false;
+        }
+
+        SaveProgramBinary(shader->id, cache_file, temp_region.arena);
+    }
+
+    // Only working programs are watched, failed ones are retried by whoever loads them
+    shader->sort_index = watched_shader_count;
+    watched_shaders[watched_shader_count++] = shader;
 
     EndTempRegion(temp_region);
+    return true;
+}
+
+// For the shaders every frame needs, so they have to load at startup
+void LoadShader(Shader *shader, const char* vertex_file, const char* frag_file)
+{
+    ShaderStage stages[] = {{GL_VERTEX_SHADER, vertex_file}, {GL_FRAGMENT_SHADER, frag_file}};
+    bool loaded = LoadProgram(shader, stages, lengthof(stages), 0);
+    assert(loaded);
+}
 
-    return shader;
+void LoadComputeShader(Shader *shader, const char* compute_file)
+{
+    ShaderStage stages[] = {{GL_COMPUTE_SHADER, compute_file}};
+    bool loaded = LoadProgram(shader, stages, lengthof(stages), 0);
+    assert(loaded);
+}
+
+void InitializePermutations(ShaderPermutations *permutations, const char* vertex_file, const char* frag_file)
+{
+    *permutations = {};
+    permutations->stages[0] = {GL_VERTEX_SHADER, vertex_file};
+    permutations->stages[1] = {GL_FRAGMENT_SHADER, frag_file};
+    permutations->stage_count = 2;
+}
+
+// Blocks on the first use of a variant, after that the program cache makes it a load.
+// NULL while the variant does not compile, the draws that need it are skipped.
+// A failed variant is tried again once its sources change.
+Shader *GetShaderVariant(ShaderPermutations *permutations, u32 features)
+{
+    assert(features < ShaderFeature_VariantCount);
+    assert(!(features & ShaderFeature_Quantized) || (features & ShaderFeature_Instanced));
+    assert(!(features & ShaderFeature_Lit) || (features & ShaderFeature_Quantized));
+
+    Shader *variant = permutations->variants + features;
+    if (variant->id)
+    {
+        return variant;
+    }
+
+    // A failed variant keeps the write time of the sources that did not compile,
+    // so broken sources wait for the next save. Unreadable ones (write_time 0)
+    // are retried every frame.
+    if (variant->stage_count && variant->write_time && ShaderWriteTime(variant) == variant->write_time)
+    {
+        return NULL;
+    }
+
+    return LoadProgram(variant, permutations->stages, permutations->stage_count, features) ? variant : NULL;
 }
 
-Mesh CreateMesh(Vertex *vertices, u32  vertex_count, u32 *indices, u32 index_count)
+// The cheapest variant that draws the mesh correctly
+inline u32 MeshShaderFeatures(Mesh *mesh)
 {
+    u32 features = ShaderFeature_Instanced | ShaderFeature_Quantized;
+    if (mesh->has_normals)
+    {
+        features |= ShaderFeature_Lit;
+    }
+    return features;
+}
+
+void ReloadShaders()
+{
+    for (u32 i = 0; i < watched_shader_count; ++i)
+    {
+        Shader *shader = watched_shaders[i];
+
+        if (shader->pending_program)
+        {
+            // Without the extension the status query below just blocks, but a
+            // frame after the link was issued rather than on the spot
+            i32 complete = 1;
+            if (parallel_shader_compile)
+            {
+                glGetProgramiv(shader->pending_program, GL_COMPLETION_STATUS_KHR, &complete);
+            }
+
+            if (!complete)
+            {
+                continue;
+            }
+
+            // On errors the old program keeps drawing until the next save
+            if (EndCompileProgram(shader, shader->pending_program, shader->pending_stages))
+            {
+                glDeleteProgram(shader->id);
+                shader->id = shader->pending_program;
+                printf("Reloaded shader (%s)\n", shader->stages[0].file);
+
+                TempMemory temp_region = ScratchAllocate();
+                char cache_file[64];
+                ShaderCacheFile(cache_file, sizeof(cache_file), shader->pending_hash);
+                SaveProgramBinary(shader->id, cache_file, temp_region.arena);
+                EndTempRegion(temp_region);
+            }
+            else
+            {
+                glDeleteProgram(shader->pending_program);
+            }
+
+            shader->pending_program = 0;
+            continue;
+        }
+
+        // Saves made during a pending compile are picked up once it is done
+        u64 write_time = ShaderWriteTime(shader);
+        if (!write_time || write_time == shader->write_time)
+        {
+            continue;
+        }
+
+        // The write time stays old on a failed read, so the next frame tries again
+        TempMemory temp_region = ScratchAllocate();
+        u8 *code[MAX_SHADER_STAGES];
+        if (ReadShaderSources(shader, code, &shader->pending_hash, temp_region.arena))
+        {
+            shader->write_time = write_time;
+            shader->pending_program = BeginCompileProgram(shader, code, shader->pending_stages);
+        }
+        EndTempRegion(temp_region);
+    }
+}
+
+// Appends the mesh to the shared buffers, meshes are never freed
+Mesh CreateMesh(PackedVertex *vertices, u32 vertex_count, u32 *indices, u32 index_count)
+{
+    assert(mesh_vertex_count + vertex_count <= MESH_BUFFER_VERTICES);
+    assert(mesh_index_count + index_count <= MESH_BUFFER_INDICES);
+
     Mesh mesh = {};
+    mesh.id = mesh_count++;
     mesh.index_count = index_count;
+    mesh.first_index = mesh_index_count;
+    mesh.base_vertex = mesh_vertex_count;
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh_vertex_buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(PackedVertex) * mesh_vertex_count, sizeof(PackedVertex) * vertex_count, vertices);
+
+    // Indices stay relative to the mesh, base_vertex offsets them at draw time
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh_index_buffer);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(u32) * mesh_index_count, sizeof(u32) * index_count, indices);
 
-    glGenVertexArrays(1, &mesh.vao);
-    glBindVertexArray(mesh.vao);
+    mesh_vertex_count += vertex_count;
+    mesh_index_count += index_count;
 
-    u32 buffers[2];
-    glGenBuffers(2, buffers);
-    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertex_count, vertices, GL_STATIC_DRAW);
+    return mesh;
+}
+
+void InitializeMeshBuffers()
+{
+    glGenVertexArrays(1, &mesh_vao);
+    glBindVertexArray(mesh_vao);
+
+    glGenBuffers(1, &mesh_vertex_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh_vertex_buffer);
+    glBufferStorage(GL_ARRAY_BUFFER, sizeof(PackedVertex) * MESH_BUFFER_VERTICES, NULL, GL_DYNAMIC_STORAGE_BIT);
 
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(Vertex), (void*) offsetof(Vertex, position));
+    glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, true, sizeof(PackedVertex), (void*) offsetof(PackedVertex, position));
 
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, false, sizeof(Vertex), (void*) offsetof(Vertex, normal));
+    glVertexAttribPointer(1, 2, GL_SHORT, true, sizeof(PackedVertex), (void*) offsetof(PackedVertex, normal));
 
     glEnableVertexAttribArray(2);
-    glVertexAttribPointer(3, 2, GL_FLOAT, false, sizeof(Vertex), (void*) offsetof(Vertex, uv));
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, false, sizeof(PackedVertex), (void*) offsetof(PackedVertex, uv));
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(u32) * index_count, indices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, true, sizeof(PackedVertex), (void*) offsetof(PackedVertex, color));
 
-    glBindVertexArray(0);
+    // Element buffer binding is vao state
+    glGenBuffers(1, &mesh_index_buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh_index_buffer);
+    glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, sizeof(u32) * MESH_BUFFER_INDICES, NULL, GL_DYNAMIC_STORAGE_BIT);
 
-    return mesh;
+    glBindVertexArray(0);
 }
 
 // Api lifecycle
 //
 
-void InitializeRenderer()
+void InitializeRenderer(PlatformApi *platform)
 {
+    renderer_platform = platform;
+
     glEnable(GL_CULL_FACE);
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
 
-    default_shader = LoadShader("shader/default.vert", "shader/default.frag");
+    i32 extension_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+    for (i32 i = 0; i < extension_count; ++i)
+    {
+        const char *extension = (const char *) glGetStringi(GL_EXTENSIONS, i);
+        if (strcmp(extension, "GL_KHR_parallel_shader_compile") == 0)
+        {
+            parallel_shader_compile = true;
+        }
+    }
+
+    InitializePermutations(&world_shaders, "shader/world.vert", "shader/default.frag");
+    LoadShader(&quad_shader, "shader/quad.vert", "shader/default.frag");
+    LoadComputeShader(&cull_shader, "shader/cull_instances.comp");
+    LoadShader(&tilemap_shader, "shader/tilemap.vert", "shader/tilemap.frag");
+    LoadShader(&level_cache_shader, "shader/level_cache.vert", "shader/level_cache.frag");
 
     glGenBuffers(1, &uniform_buffer);
     glBindBuffer(GL_UNIFORM_BUFFER, uniform_buffer);
@@ -135,11 +712,53 @@ void InitializeRenderer()
     glBindBufferBase(GL_UNIFORM_BUFFER, 1, uniform_buffer);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-    glGenVertexArrays(1, &vertex_vao);
-    glBindVertexArray(vertex_vao);
+    glGenVertexArrays(1, &quad_vao);
+    glBindVertexArray(quad_vao);
+
+    glGenBuffers(1, &quad_gpu_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, quad_gpu_buffer);
 
-    glGenBuffers(1, &vertex_gpu_buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_gpu_buffer);
+    // Coherent, so the game's writes are visible without explicit flushes
+    GLbitfield map_flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    u64 ring_size = sizeof(QuadInstance) * FRAME_REGION_QUADS * FRAME_REGION_COUNT;
+    glBufferStorage(GL_ARRAY_BUFFER, ring_size, NULL, map_flags);
+    mapped_quads = (QuadInstance *) glMapBufferRange(GL_ARRAY_BUFFER, 0, ring_size, map_flags);
+    assert(mapped_quads);
+
+    glGenBuffers(1, &mesh_instance_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mesh_instance_buffer);
+    u64 instance_ring_size = sizeof(MeshInstance) * FRAME_REGION_MESH_INSTANCES * FRAME_REGION_COUNT;
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, instance_ring_size, NULL, map_flags);
+    mapped_mesh_instances = (MeshInstance *) glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, instance_ring_size, map_flags);
+    assert(mapped_mesh_instances);
+
+    // Only the gpu writes and reads it
+    glGenBuffers(1, &visible_instance_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visible_instance_buffer);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, instance_ring_size, NULL, 0);
+
+    glGenBuffers(1, &indirect_buffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
+    u64 indirect_ring_size = sizeof(DrawElementsIndirectCommand) * FRAME_REGION_DRAWS * FRAME_REGION_COUNT;
+    glBufferStorage(GL_DRAW_INDIRECT_BUFFER, indirect_ring_size, NULL, map_flags);
+    mapped_draws = (DrawElementsIndirectCommand *) glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, indirect_ring_size, map_flags);
+    assert(mapped_draws);
+
+    // One instance per quad. The pointers are set per frame, they depend on the current region.
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(0, 1);
+    glVertexAttribDivisor(1, 1);
+    glVertexAttribDivisor(2, 1);
+
+    // Immutable storage, only ever updated a slot at a time
+    glGenVertexArrays(1, &level_vao);
+    glBindVertexArray(level_vao);
+
+    glGenBuffers(1, &level_gpu_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, level_gpu_buffer);
+    glBufferStorage(GL_ARRAY_BUFFER, sizeof(Vertex) * LEVEL_SLOT_VERTICES * MAX_LEVEL_CHUNKS, NULL, GL_DYNAMIC_STORAGE_BIT);
 
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
@@ -147,11 +766,479 @@ void InitializeRenderer()
     glVertexAttribPointer(1, 3, GL_FLOAT, false, sizeof(Vertex), (void*) offsetof(Vertex, color));
 
     glBindVertexArray(0);
+
+    // One layer of tile indices per slot. Integer textures must use nearest filtering.
+    glGenTextures(1, &level_texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, level_texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R8UI, CHUNK_SIZE, CHUNK_SIZE, MAX_LEVEL_CHUNKS);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Start out matching the zeroed mirrors
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (u32 s = 0; s < MAX_LEVEL_CHUNKS; ++s)
+    {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, s, CHUNK_SIZE, CHUNK_SIZE, 1,
+                        GL_RED_INTEGER, GL_UNSIGNED_BYTE, level_slots[s].tiles);
+    }
+
+    // The texture is attached once the window size is known
+    glGenFramebuffers(1, &level_cache.framebuffer);
+
+    InitializeMeshBuffers();
+}
+
+// Level geometry
+//
+
+inline void PushLevelQuad(Vertex *out, V2 topleft, V2 size, V3 color)
+{
+    // Same corners and winding as the quad strips of shader/quad.vert
+    V3 p0 = v3(topleft, 0);
+    V3 p1 = v3(topleft + v2(size.x, 0), 0);
+    V3 p2 = v3(topleft + v2(0, size.y), 0);
+    V3 p3 = v3(topleft + size, 0);
+    V3 corners[6] = { p0, p1, p2, p2, p1, p3 };
+
+    for (u32 i = 0; i < 6; ++i)
+    {
+        out[i].position = corners[i];
+        out[i].normal = v3(0, 0, 1);
+        out[i].uv = v2(0, 0);
+        out[i].color = color;
+    }
 }
 
-inline void MultiDrawCommand(MultiDraw *draw)
+// Merges runs of equal tiles into maximal rectangles: grow right as far as the
+// tile repeats, then down while the whole row segment matches. Returns the vertex count.
+u32 GreedyMeshChunk(LevelChunk *chunk, V3 *tile_colors, Vertex *out)
 {
-    glMultiDrawArrays(GL_TRIANGLE_STRIP, draw->offsets, draw->counts, draw->primitive_count);
+    bool done[CHUNK_SIZE * CHUNK_SIZE] = {};
+    V2 origin = v2(chunk->x, chunk->y) * (CHUNK_SIZE * TILE_SIZE);
+    u32 vertex_count = 0;
+
+    for (u32 y = 0; y < CHUNK_SIZE; ++y)
+    {
+        for (u32 x = 0; x < CHUNK_SIZE; ++x)
+        {
+            u32 start = y * CHUNK_SIZE + x;
+            u8 tile = chunk->tiles[start];
+            if (done[start] || tile == 0)
+            {
+                continue;
+            }
+
+            u32 width = 1;
+            while (x + width < CHUNK_SIZE && !done[start + width] && chunk->tiles[start + width] == tile)
+            {
+                width++;
+            }
+
+            u32 height = 1;
+            for (; y + height < CHUNK_SIZE; ++height)
+            {
+                u32 row = start + height * CHUNK_SIZE;
+                bool match = true;
+                for (u32 i = 0; i < width && match; ++i)
+                {
+                    match = !done[row + i] && chunk->tiles[row + i] == tile;
+                }
+
+                if (!match)
+                {
+                    break;
+                }
+            }
+
+            for (u32 j = 0; j < height; ++j)
+            {
+                for (u32 i = 0; i < width; ++i)
+                {
+                    done[start + j * CHUNK_SIZE + i] = true;
+                }
+            }
+
+            V2 topleft = origin + v2(x, y) * TILE_SIZE;
+            PushLevelQuad(out + vertex_count, topleft, v2(width, height) * TILE_SIZE, tile_colors[tile]);
+            vertex_count += 6;
+        }
+    }
+
+    return vertex_count;
+}
+
+// Upload the bounding rectangle of the tiles that differ from the slot's
+// layer, so a single tile edit is a single texel
+void UpdateLevelTexture(LevelSlot *slot, LevelChunk *chunk)
+{
+    u32 slot_index = (u32) (slot - level_slots);
+
+    u32 min_x = CHUNK_SIZE, min_y = CHUNK_SIZE;
+    u32 max_x = 0, max_y = 0;
+    for (u32 y = 0; y < CHUNK_SIZE; ++y)
+    {
+        for (u32 x = 0; x < CHUNK_SIZE; ++x)
+        {
+            u32 index = y * CHUNK_SIZE + x;
+            if (slot->tiles[index] != chunk->tiles[index])
+            {
+                min_x = x < min_x ? x : min_x;
+                min_y = y < min_y ? y : min_y;
+                max_x = x > max_x ? x : max_x;
+                max_y = y > max_y ? y : max_y;
+            }
+        }
+    }
+
+    if (min_x <= max_x && min_y <= max_y)
+    {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, level_texture);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, CHUNK_SIZE);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, min_x, min_y, slot_index,
+                        max_x - min_x + 1, max_y - min_y + 1, 1,
+                        GL_RED_INTEGER, GL_UNSIGNED_BYTE, chunk->tiles + min_y * CHUNK_SIZE + min_x);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+        memcpy(slot->tiles, chunk->tiles, sizeof(slot->tiles));
+    }
+
+    slot->texture_version = chunk->version;
+}
+
+// Refreshes the chunks whose version changed and frees the slots of chunks
+// that are gone. Nothing is uploaded while the level is static. Returns
+// whether anything about the level changed.
+bool UpdateLevelSlots(RenderData *render_data)
+{
+    TimeFunction;
+
+    frame_index++;
+    bool changed = false;
+
+    for (u32 i = 0; i < render_data->level_chunk_count; ++i)
+    {
+        LevelChunk *chunk = render_data->level_chunks + i;
+
+        LevelSlot *slot = NULL;
+        LevelSlot *free_slot = NULL;
+        for (u32 s = 0; s < MAX_LEVEL_CHUNKS && !slot; ++s)
+        {
+            LevelSlot *candidate = level_slots + s;
+            if (candidate->in_use && candidate->x == chunk->x && candidate->y == chunk->y)
+            {
+                slot = candidate;
+            }
+            else if (!candidate->in_use && !free_slot)
+            {
+                free_slot = candidate;
+            }
+        }
+
+        if (!slot)
+        {
+            assert(free_slot);
+            slot = free_slot;
+            slot->in_use = true;
+            slot->x = chunk->x;
+            slot->y = chunk->y;
+            slot->mesh_version = chunk->version - 1;
+            slot->texture_version = chunk->version - 1;
+            changed = true;
+        }
+
+        slot->last_frame = frame_index;
+
+        if (render_data->level_mode == LevelRender_Tilemap)
+        {
+            if (slot->texture_version != chunk->version)
+            {
+                UpdateLevelTexture(slot, chunk);
+                changed = true;
+            }
+            continue;
+        }
+
+        if (slot->mesh_version == chunk->version)
+        {
+            continue;
+        }
+        changed = true;
+
+        TempMemory temp_region = ScratchAllocate();
+        Vertex *vertices = PushArray(temp_region.arena, Vertex, LEVEL_SLOT_VERTICES);
+        slot->vertex_count = GreedyMeshChunk(chunk, render_data->tile_colors, vertices);
+        slot->mesh_version = chunk->version;
+
+        u32 slot_index = (u32) (slot - level_slots);
+        glBindBuffer(GL_ARRAY_BUFFER, level_gpu_buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(Vertex) * LEVEL_SLOT_VERTICES * slot_index,
+                        sizeof(Vertex) * slot->vertex_count, vertices);
+        EndTempRegion(temp_region);
+    }
+
+    for (u32 s = 0; s < MAX_LEVEL_CHUNKS; ++s)
+    {
+        if (level_slots[s].in_use && level_slots[s].last_frame != frame_index)
+        {
+            level_slots[s].in_use = false;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+// Culling
+//
+
+// Writes the indices of the commands that intersect the frustum. Mesh
+// instances are culled on the gpu, see SubmitMeshCommands.
+u32 CullCommands(Frustum *frustum, RenderCommand *commands, u32 command_count, u32 *visible, Arena *arena)
+{
+    BoxBounds bounds = PushBoxBounds(arena, command_count);
+    for (u32 i = 0; i < command_count; ++i)
+    {
+        RenderCommand *command = commands + i;
+        // Big rather than infinite, 0 * inf in the plane test would be NaN
+        V3 min = v3(-1e30f);
+        V3 max = v3(1e30f);
+
+        // Debug geometry is never culled, the level culls its own chunks and
+        // meshes are culled on the gpu
+        if (command->layer != RenderLayer_Debug && command->type == RenderCommand_Quads)
+        {
+            min = v3(command->quads.bounds_min, 0);
+            max = v3(command->quads.bounds_max, 0);
+        }
+
+        AddBox(&bounds, min, max);
+    }
+
+    return CullBoxes(frustum, &bounds, visible);
+}
+
+// Writes the indices of the level slots whose chunk intersects the frustum
+u32 CullLevelSlots(Frustum *frustum, u32 *visible_slots, Arena *arena)
+{
+    f32 chunk_pixels = CHUNK_SIZE * TILE_SIZE;
+
+    BoxBounds bounds = PushBoxBounds(arena, MAX_LEVEL_CHUNKS);
+    u32 *slots = PushArray(arena, u32, MAX_LEVEL_CHUNKS);
+    for (u32 s = 0; s < MAX_LEVEL_CHUNKS; ++s)
+    {
+        LevelSlot *slot = level_slots + s;
+        if (slot->in_use)
+        {
+            V3 min = v3(slot->x * chunk_pixels, slot->y * chunk_pixels, 0);
+            slots[bounds.count] = s;
+            AddBox(&bounds, min, min + v3(chunk_pixels, chunk_pixels, 0));
+        }
+    }
+
+    u32 *visible = PushArray(arena, u32, bounds.capacity);
+    u32 visible_count = CullBoxes(frustum, &bounds, visible);
+
+    for (u32 i = 0; i < visible_count; ++i)
+    {
+        visible_slots[i] = slots[visible[i]];
+    }
+
+    return visible_count;
+}
+
+// One draw range for every visible slot that has geometry
+MultiDraw LevelSlotsToDraw(u32 *visible_slots, u32 visible_count, Arena *arena)
+{
+    MultiDraw result = {};
+    result.offsets = PushArray(arena, i32, visible_count);
+    result.counts = PushArray(arena, i32, visible_count);
+    for (u32 i = 0; i < visible_count; ++i)
+    {
+        LevelSlot *slot = level_slots + visible_slots[i];
+        if (slot->vertex_count)
+        {
+            result.offsets[result.primitive_count] = LEVEL_SLOT_VERTICES * visible_slots[i];
+            result.counts[result.primitive_count] = slot->vertex_count;
+            result.primitive_count++;
+        }
+    }
+
+    return result;
+}
+
+// Every visible chunk is one instance of a quad that looks its tiles up in the level texture
+void DrawLevelTilemap(RenderData *render_data, u32 *visible_slots, u32 visible_count)
+{
+    i32 chunks[MAX_LEVEL_CHUNKS][4];
+    for (u32 i = 0; i < visible_count; ++i)
+    {
+        LevelSlot *slot = level_slots + visible_slots[i];
+        chunks[i][0] = slot->x;
+        chunks[i][1] = slot->y;
+        chunks[i][2] = visible_slots[i];
+        chunks[i][3] = 0;
+    }
+
+    glUseProgram(tilemap_shader.id);
+    glUniform3fv(TILEMAP_PALETTE_LOCATION, MAX_TILE_TYPES, &render_data->tile_colors[0].x);
+    glUniform4iv(TILEMAP_CHUNKS_LOCATION, visible_count, chunks[0]);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, level_texture);
+
+    // The shader builds the quad from gl_VertexID, the bound vao only has to exist
+    glBindVertexArray(level_vao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, visible_count);
+}
+
+// Draws the resident level chunks inside the frustum with the current level mode
+void DrawLevel(RenderData *render_data, Frustum *frustum, Arena *arena)
+{
+    u32 *visible_slots = PushArray(arena, u32, MAX_LEVEL_CHUNKS);
+    u32 visible_count = CullLevelSlots(frustum, visible_slots, arena);
+
+    if (render_data->level_mode == LevelRender_Tilemap)
+    {
+        DrawLevelTilemap(render_data, visible_slots, visible_count);
+        return;
+    }
+
+    MultiDraw draw = LevelSlotsToDraw(visible_slots, visible_count, arena);
+
+    Shader *shader = GetShaderVariant(&world_shaders, 0);
+    if (!shader)
+    {
+        return;
+    }
+
+    glUseProgram(shader->id);
+    Mat4 identity = Identity();
+    glUniformMatrix4fv(MODEL_UNIFORM_LOCATION, 1, GL_FALSE, identity.v);
+
+    glBindVertexArray(level_vao);
+    glMultiDrawArrays(GL_TRIANGLES, draw.offsets, draw.counts, draw.primitive_count);
+}
+
+// Level cache
+//
+
+// Makes sure the cache covers the view, rendering the level into it again when
+// the view left the cached region or the cache was invalidated. Overwrites the
+// uniform buffer.
+void UpdateLevelCache(RenderData *render_data, V2 view_min, V2 view_max, f32 texels_per_unit, Arena *arena)
+{
+    TimeFunction;
+
+    V2 half_size = (view_max - view_min) * 0.5 + v2(LEVEL_CACHE_PADDING);
+    i32 width = (i32) (2 * half_size.x * texels_per_unit);
+    i32 height = (i32) (2 * half_size.y * texels_per_unit);
+
+    if (width != level_cache.width || height != level_cache.height)
+    {
+        // Immutable storage can't be resized, so a new window size gets a new texture
+        glDeleteTextures(1, &level_cache.texture);
+        glGenTextures(1, &level_cache.texture);
+        glBindTexture(GL_TEXTURE_2D, level_cache.texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, level_cache.framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, level_cache.texture, 0);
+        assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        level_cache.width = width;
+        level_cache.height = height;
+        level_cache.valid = false;
+    }
+
+    bool covered = view_min.x >= level_cache.min.x && view_min.y >= level_cache.min.y &&
+                   view_max.x <= level_cache.max.x && view_max.y <= level_cache.max.y;
+
+    if (level_cache.valid && covered && level_cache.mode == render_data->level_mode)
+    {
+        return;
+    }
+
+    V2 center = (view_min + view_max) * 0.5;
+    level_cache.min = center - half_size;
+    level_cache.max = center + half_size;
+    level_cache.mode = render_data->level_mode;
+    level_cache.valid = true;
+
+    // The level is flat at z = 0, so a thin slab looking down -z is enough
+    UniformBuffer cache_uniforms;
+    cache_uniforms.projection = Ortho(level_cache.min.x, level_cache.max.x, level_cache.min.y, level_cache.max.y, -1, 1);
+    cache_uniforms.view = Identity();
+
+    glBindBuffer(GL_UNIFORM_BUFFER, uniform_buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(UniformBuffer), &cache_uniforms);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, level_cache.framebuffer);
+    glViewport(0, 0, width, height);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_DEPTH_TEST);
+
+    Frustum frustum = ExtractFrustum(cache_uniforms.projection);
+    DrawLevel(render_data, &frustum, arena);
+
+    glEnable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DrawLevelCache()
+{
+    glUseProgram(level_cache_shader.id);
+    glUniform4f(LEVEL_CACHE_RECT_LOCATION, level_cache.min.x, level_cache.min.y, level_cache.max.x, level_cache.max.y);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, level_cache.texture);
+
+    glBindVertexArray(level_vao);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+// Frame vertices
+//
+
+QuadInstance *BeginFrame(u32 *quad_capacity)
+{
+    TimeFunction;
+
+    current_region = (current_region + 1) % FRAME_REGION_COUNT;
+
+    // Only blocks when the gpu is FRAME_REGION_COUNT frames behind
+    GLsync fence = region_fences[current_region];
+    if (fence)
+    {
+        GLenum result;
+        do
+        {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        } while (result == GL_TIMEOUT_EXPIRED);
+        assert(result != GL_WAIT_FAILED);
+
+        glDeleteSync(fence);
+        region_fences[current_region] = NULL;
+    }
+
+    *quad_capacity = FRAME_REGION_QUADS;
+    return mapped_quads + FRAME_REGION_QUADS * current_region;
+}
+
+// Four strip corners per instance, the batch's quads are instances first..first + count
+inline void QuadBatchCommand(QuadBatch *batch)
+{
+    if (batch->count)
+    {
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, batch->count, batch->first);
+    }
 }
 
 inline void SingleDrawCommand(SingleDraw *draw)
@@ -159,8 +1246,254 @@ inline void SingleDrawCommand(SingleDraw *draw)
     glDrawArrays(GL_TRIANGLE_STRIP, draw->offset, draw->count);
 }
 
+// Command sorting
+//
+
+// View distances past this all sort as the farthest
+#define SORT_DEPTH_RANGE 1000
+
+// Most significant first: layer 4 bits, shader 6, material 10, mesh 16, depth 28.
+// Within a layer commands group by shader, then texture, then vao, and run front to back.
+// shader is a Shader's sort_index
+inline u64 RenderSortKey(u32 layer, u32 shader, u32 material, u32 mesh, f32 depth)
+{
+    assert(shader <= 0x3f);
+    u64 quantized_depth = (u64) (Clamp(depth / SORT_DEPTH_RANGE, 0, 1) * ((1 << 28) - 1));
+    return ((u64) (layer & 0xf) << 60) |
+           ((u64) (shader & 0x3f) << 54) |
+           ((u64) (material & 0x3ff) << 44) |
+           ((u64) (mesh & 0xffff) << 28) |
+           quantized_depth;
+}
+
+// Sort index of the shader the level is drawn with
+inline u32 LevelShader(RenderData *render_data)
+{
+    if (render_data->orthographic)
+    {
+        return level_cache_shader.sort_index;
+    }
+    if (render_data->level_mode == LevelRender_Tilemap)
+    {
+        return tilemap_shader.sort_index;
+    }
+
+    Shader *shader = GetShaderVariant(&world_shaders, 0);
+    return shader ? shader->sort_index : 0;
+}
+
+u64 CommandSortKey(RenderData *render_data, RenderCommand *command, V3 camera_pos)
+{
+    switch (command->type)
+    {
+        case RenderCommand_Level:
+        {
+            return RenderSortKey(command->layer, LevelShader(render_data), 0, level_vao, 0);
+        }
+        case RenderCommand_Quads:
+        {
+            V2 center = (command->quads.bounds_min + command->quads.bounds_max) * 0.5;
+            f32 depth = Length(v3(center, 0) - camera_pos);
+            return RenderSortKey(command->layer, quad_shader.sort_index, 0, quad_vao, depth);
+        }
+        case RenderCommand_Mesh:
+        {
+            V3 position = v3(command->transform.v[12], command->transform.v[13], command->transform.v[14]);
+            f32 depth = Length(position - camera_pos);
+            Shader *shader = GetShaderVariant(&world_shaders, MeshShaderFeatures(&command->mesh));
+            return RenderSortKey(command->layer, shader ? shader->sort_index : 0, 0, command->mesh.id, depth);
+        }
+    }
+
+    assert(0);
+    return 0;
+}
+
+// Submission skips binds of what is already bound
+u32 bound_program;
+u32 bound_vao;
+
+inline void UseProgram(u32 program)
+{
+    if (program != bound_program)
+    {
+        glUseProgram(program);
+        bound_program = program;
+    }
+}
+
+inline void BindVertexArray(u32 vao)
+{
+    if (vao != bound_vao)
+    {
+        glBindVertexArray(vao);
+        bound_vao = vao;
+    }
+}
+
+void SubmitCommand(RenderData *render_data, RenderCommand *command, Frustum *frustum, Arena *arena)
+{
+    switch (command->type)
+    {
+        case RenderCommand_Level:
+        {
+            if (render_data->orthographic)
+            {
+                DrawLevelCache();
+            }
+            else
+            {
+                DrawLevel(render_data, frustum, arena);
+            }
+
+            // Binds whatever it needs itself
+            bound_program = 0;
+            bound_vao = 0;
+        } break;
+
+        case RenderCommand_Quads:
+        {
+            UseProgram(quad_shader.id);
+            BindVertexArray(quad_vao);
+            QuadBatchCommand(&command->quads);
+        } break;
+
+        case RenderCommand_Mesh:
+        {
+            // Goes through SubmitMeshCommands
+            assert(0);
+        } break;
+    }
+}
+
+#ifdef CHECK_GPU_CULLING
+// The sphere test of shader/cull_instances.comp on the cpu, as a reference for
+// the compute pass. Reads the instance counts back, which stalls the frame, so
+// it is only built with CHECK_GPU_CULLING.
+void CheckMeshCulling(Frustum *frustum, RenderData *render_data, u32 *order, u32 count,
+                      u32 *instance_draws, u32 first_draw, Arena *arena)
+{
+    SphereBounds spheres = PushSphereBounds(arena, count);
+    for (u32 i = 0; i < count; ++i)
+    {
+        RenderCommand *command = render_data->commands + order[i];
+        Mat4 m = command->transform;
+        V3 extent = command->mesh.bounds_max - command->mesh.bounds_min;
+        V3 center = TransformPoint(m, command->mesh.bounds_min + extent * 0.5);
+
+        f32 scale_sq = Max(Dot(v3(m.v[0], m.v[1], m.v[2]), v3(m.v[0], m.v[1], m.v[2])),
+                       Max(Dot(v3(m.v[4], m.v[5], m.v[6]), v3(m.v[4], m.v[5], m.v[6])),
+                           Dot(v3(m.v[8], m.v[9], m.v[10]), v3(m.v[8], m.v[9], m.v[10]))));
+        AddSphere(&spheres, center, Length(extent) * 0.5 * sqrtf(scale_sq));
+    }
+
+    u32 *visible = PushArray(arena, u32, spheres.capacity);
+    u32 visible_count = CullSpheres(frustum, &spheres, visible);
+
+    u32 span_draws = draw_count - first_draw;
+    u32 *expected = PushArrayZero(arena, u32, span_draws);
+    for (u32 i = 0; i < visible_count; ++i)
+    {
+        expected[instance_draws[visible[i]] - first_draw]++;
+    }
+
+    DrawElementsIndirectCommand *gpu_draws = PushArray(arena, DrawElementsIndirectCommand, span_draws);
+    u64 draw_offset = sizeof(DrawElementsIndirectCommand) * (FRAME_REGION_DRAWS * current_region + first_draw);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, draw_offset, sizeof(DrawElementsIndirectCommand) * span_draws, gpu_draws);
+
+    // Instances right on a plane may round differently, anything more is a bug
+    for (u32 d = 0; d < span_draws; ++d)
+    {
+        if (gpu_draws[d].instance_count != expected[d])
+        {
+            printf("Gpu culling mismatch: draw %u has %u visible instances, the cpu test %u\n",
+                   first_draw + d, gpu_draws[d].instance_count, expected[d]);
+        }
+    }
+}
+#endif
+
+// One multi draw for a run of mesh commands. Sorting put the commands of each
+// mesh next to each other, every mesh becomes one indirect instanced draw.
+// The draws start out empty: a compute pass frustum culls every instance and
+// appends the visible ones to their draw.
+void SubmitMeshCommands(RenderData *render_data, u64 *keys, u32 *order, u32 count, Shader *shader,
+                        Frustum *frustum, Arena *arena)
+{
+    assert(mesh_instance_count + count <= FRAME_REGION_MESH_INSTANCES);
+
+#ifdef CHECK_GPU_CULLING
+    u32 *instance_draws = PushArray(arena, u32, count);
+#endif
+
+    MeshInstance *instances = mapped_mesh_instances + FRAME_REGION_MESH_INSTANCES * current_region;
+    DrawElementsIndirectCommand *draws = mapped_draws + FRAME_REGION_DRAWS * current_region;
+    u32 first_draw = draw_count;
+
+    for (u32 i = 0; i < count;)
+    {
+        // Only the depth differs within a mesh's run
+        u32 run_end = i + 1;
+        while (run_end < count && (keys[run_end] >> 28) == (keys[i] >> 28))
+        {
+            run_end++;
+        }
+
+        Mesh *mesh = &render_data->commands[order[i]].mesh;
+        V3 extent = mesh->bounds_max - mesh->bounds_min;
+
+        assert(draw_count < FRAME_REGION_DRAWS);
+        u32 draw_index = draw_count++;
+
+        // Visible instances are compacted into the same range of the visible buffer
+        DrawElementsIndirectCommand *draw = draws + draw_index;
+        draw->count = mesh->index_count;
+        draw->instance_count = 0;
+        draw->first_index = mesh->first_index;
+        draw->base_vertex = mesh->base_vertex;
+        draw->base_instance = mesh_instance_count;
+
+        for (u32 j = i; j < run_end; ++j)
+        {
+            RenderCommand *command = render_data->commands + order[j];
+            MeshInstance *instance = instances + mesh_instance_count++;
+            instance->transform = command->transform;
+            instance->bounds_min = v4(mesh->bounds_min, 0);
+            instance->bounds_extent = v4(extent, 0);
+            instance->tint = command->tint;
+            instance->draw = draw_index;
+#ifdef CHECK_GPU_CULLING
+            instance_draws[j] = draw_index;
+#endif
+        }
+
+        i = run_end;
+    }
+
+    UseProgram(cull_shader.id);
+    glUniform1ui(CULL_FIRST_INSTANCE_LOCATION, mesh_instance_count - count);
+    glUniform1ui(CULL_INSTANCE_COUNT_LOCATION, count);
+    glDispatchCompute((count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    // The draws read the instance counts and the vertex shader the visible instances
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+#ifdef CHECK_GPU_CULLING
+    CheckMeshCulling(frustum, render_data, order, count, instance_draws, first_draw, arena);
+#endif
+
+    UseProgram(shader->id);
+    BindVertexArray(mesh_vao);
+
+    u64 draw_offset = sizeof(DrawElementsIndirectCommand) * (FRAME_REGION_DRAWS * current_region + first_draw);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *) draw_offset, draw_count - first_draw, 0);
+}
+
 void DrawFrame(RenderData *render_data, i32 window_width, i32 window_height)
 {
+    TimeFunction;
+
     f32 tilesize = 32;
 
     // Draw debug rays
@@ -180,32 +1513,110 @@ void DrawFrame(RenderData *render_data, i32 window_width, i32 window_height)
     f32 aspect = (f32) window_width / (f32) window_height;
     f32 viewport_height = 540;
     f32 viewport_width = aspect * viewport_height;
-    // uniforms.projection = Ortho(0, viewport_width, viewport_height, 0, 0.1, 100);
-    uniforms.projection = perspective(45, aspect, 0.1, 1000);
-    uniforms.view = LookAt(render_data->camera_pos, render_data->camera_pos + render_data->camera_forward, v3(0, 1, 0));
+
+    // Whichever camera is active, so switching to orthographic never shows stale tiles
+    if (UpdateLevelSlots(render_data))
+    {
+        level_cache.valid = false;
+    }
+
+    TempMemory temp_region = ScratchAllocate();
+    Arena *arena = temp_region.arena;
+
+    V3 camera_pos = render_data->camera_pos;
+    if (render_data->orthographic)
+    {
+        // Top down, centered on the camera
+        V2 half_view = v2(viewport_width, viewport_height) * 0.5;
+        uniforms.projection = Ortho(-half_view.x, half_view.x, -half_view.y, half_view.y, 0.1, 1000);
+        uniforms.view = LookAt(v3(camera_pos.x, camera_pos.y, 100), v3(camera_pos.x, camera_pos.y, 0), v3(0, 1, 0));
+
+        V2 camera = v2(camera_pos.x, camera_pos.y);
+        UpdateLevelCache(render_data, camera - half_view, camera + half_view, window_height / viewport_height, arena);
+    }
+    else
+    {
+        uniforms.projection = perspective(45, aspect, 0.1, 1000);
+        uniforms.view = LookAt(camera_pos, camera_pos + render_data->camera_forward, v3(0, 1, 0));
+    }
 
     glBindBuffer(GL_UNIFORM_BUFFER, uniform_buffer);
     glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(UniformBuffer), &uniforms);
 
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_gpu_buffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * render_data->vertex_count, render_data->vertex_buffer, GL_DYNAMIC_DRAW);
+    Frustum frustum = ExtractFrustum(uniforms.projection * uniforms.view);
+
+    // Cull, then sort what is left
+    u32 command_count = render_data->command_count;
+    u32 *order = PushArray(arena, u32, BatchPadded(command_count));
+    u32 visible_count = CullCommands(&frustum, render_data->commands, command_count, order, arena);
+
+    u64 *keys = PushArray(arena, u64, visible_count);
+    for (u32 i = 0; i < visible_count; ++i)
+    {
+        keys[i] = CommandSortKey(render_data, render_data->commands + order[i], camera_pos);
+    }
+    RadixSort(keys, order, visible_count, arena);
+
+    // The game wrote straight into the current region, only the attributes have to follow it
+    u64 region_offset = sizeof(QuadInstance) * FRAME_REGION_QUADS * current_region;
+    glBindVertexArray(quad_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, quad_gpu_buffer);
+    glVertexAttribPointer(0, 2, GL_FLOAT, false, sizeof(QuadInstance), (void*) (region_offset + offsetof(QuadInstance, topleft)));
+    glVertexAttribPointer(1, 2, GL_FLOAT, false, sizeof(QuadInstance), (void*) (region_offset + offsetof(QuadInstance, size)));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, true, sizeof(QuadInstance), (void*) (region_offset + offsetof(QuadInstance, color)));
 
     glViewport(0, 0, window_width, window_height);
     glClearColor(0.1, 0.1, 0.1, 1.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glBindVertexArray(vertex_vao);
-    glUseProgram(default_shader.id);
+    // The shaders index this frame's regions, instances by gl_BaseInstance
+    u64 instance_region_size = sizeof(MeshInstance) * FRAME_REGION_MESH_INSTANCES;
+    u64 draw_region_size = sizeof(DrawElementsIndirectCommand) * FRAME_REGION_DRAWS;
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, MESH_INSTANCE_BINDING, mesh_instance_buffer,
+                      instance_region_size * current_region, instance_region_size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, VISIBLE_INSTANCE_BINDING, visible_instance_buffer,
+                      instance_region_size * current_region, instance_region_size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, INDIRECT_DRAW_BINDING, indirect_buffer,
+                      draw_region_size * current_region, draw_region_size);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
+    mesh_instance_count = 0;
+    draw_count = 0;
 
-    MultiDrawCommand(&render_data->level);
-    MultiDrawCommand(&render_data->entities);
-    MultiDrawCommand(&render_data->player);
-    MultiDrawCommand(&render_data->debug);
-
-    for (u32 i = 0; i < render_data->mesh_count; ++i)
+    bound_program = 0;
+    bound_vao = 0;
+    for (u32 i = 0; i < visible_count;)
     {
-        Mesh *mesh = render_data->meshes + i;
-        glBindVertexArray(mesh->vao);
-        glDrawElements(GL_TRIANGLES, mesh->index_count, GL_UNSIGNED_INT, NULL);
+        RenderCommand *command = render_data->commands + order[i];
+        if (command->type != RenderCommand_Mesh)
+        {
+            SubmitCommand(render_data, command, &frustum, arena);
+            i++;
+            continue;
+        }
+
+        // One multi draw per variant
+        u32 features = MeshShaderFeatures(&command->mesh);
+        u32 run_end = i + 1;
+        while (run_end < visible_count)
+        {
+            RenderCommand *next = render_data->commands + order[run_end];
+            if (next->type != RenderCommand_Mesh || MeshShaderFeatures(&next->mesh) != features)
+            {
+                break;
+            }
+            run_end++;
+        }
+
+        Shader *shader = GetShaderVariant(&world_shaders, features);
+        if (shader)
+        {
+            SubmitMeshCommands(render_data, keys + i, order + i, run_end - i, shader, &frustum, arena);
+        }
+        i = run_end;
     }
+
+    // The region can be handed out again once the gpu is past this frame
+    region_fences[current_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    EndTempRegion(temp_region);
 }
@@ -3,6 +3,7 @@
 #include "defines.h"
 #include "memory.h"
 #include "game_math.h"
+#include "transform.h"
 
 struct FileRead
 {
@@ -12,6 +13,64 @@ struct FileRead
 
 FileRead ReadFile(const char *filename, Arena *arena);
 
+// Platform api...
+//
+
+// x86 does not reorder stores with stores or loads with loads, so keeping the
+// compiler from doing it is enough.
+#ifdef _MSC_VER
+#define CompletePreviousWrites() _WriteBarrier()
+#define CompletePreviousReads() _ReadBarrier()
+#else
+#define CompletePreviousWrites() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define CompletePreviousReads() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#endif
+
+struct WorkQueue;
+typedef void WorkCallback(void *data);
+
+// Entries are run by worker threads in any order. Only the main thread adds work.
+typedef void AddWorkCall(WorkQueue *queue, WorkCallback *callback, void *data);
+typedef void CompleteAllWorkCall(WorkQueue *queue);
+
+// Both are safe to call from worker threads. ReadFileInto fails unless the
+// file exists and is exactly size bytes.
+typedef bool ReadFileIntoCall(const char *filename, void *memory, u64 size);
+typedef bool WriteFileCall(const char *filename, void *memory, u64 size);
+
+// Read only view of a whole file, memory is NULL when it could not be mapped
+struct MappedFile
+{
+    void *memory;
+    u64 size;
+};
+
+typedef MappedFile MapFileCall(const char *filename);
+typedef void UnmapFileCall(MappedFile *file);
+// 0 when the file does not exist
+typedef u64 GetFileWriteTimeCall(const char *filename);
+
+struct QuadInstance;
+
+struct PlatformApi
+{
+    WorkQueue *work_queue;
+    AddWorkCall *AddWork;
+    CompleteAllWorkCall *CompleteAllWork;
+
+    ReadFileIntoCall *ReadFileInto;
+    WriteFileCall *WriteFile;
+
+    MapFileCall *MapFile;
+    UnmapFileCall *UnmapFile;
+    GetFileWriteTimeCall *GetFileWriteTime;
+
+    // Where this frame's quads go, set before every GameUpdate. Persistently
+    // mapped gpu memory, so write only: reading it back is very slow.
+    QuadInstance *frame_quads;
+    u32 frame_quad_capacity;
+};
+
 // Inputs...
 //
 
@@ -23,6 +82,7 @@ enum Key
     Key_D,
     Key_C,
     Key_R,
+    Key_T,
     Key_Count,
 };
 
@@ -46,16 +106,30 @@ inline bool KeyDown(Key key)
 
 inline bool KeyJustDown(Key key)
 {
-    return (input->key_states & (1 << key)) && !(input->prev_key_states && (1 << key));
+    return (input->key_states & (1 << key)) && !(input->prev_key_states & (1 << key));
 }
 
 // Renderer api...
 //
 
+// Tiles per chunk side, pixels per tile side
+#define CHUNK_SIZE 16
+#define TILE_SIZE 32
+
+// A range of the renderer's shared mesh buffers
 struct Mesh
 {
-    u32 vao;
+    u32 id;
     u32 index_count;
+    u32 first_index;
+    i32 base_vertex;
+
+    // Object space bounds, computed at import
+    V3 bounds_min;
+    V3 bounds_max;
+
+    // Meshes imported without normals draw unlit
+    bool has_normals;
 };
 
 struct Vertex
@@ -66,6 +140,19 @@ struct Vertex
     V3 color;
 };
 
+// Static mesh vertex, 20 bytes instead of the 44 of Vertex. Built by
+// PackVertices, decoded in shader/world.vert.
+struct PackedVertex
+{
+    // unorm16 fraction of the mesh bounds, w unused
+    u16 position[4];
+    // snorm16 octahedral encoded unit normal
+    i16 normal[2];
+    // Half floats
+    u16 uv[2];
+    u8 color[4];
+};
+
 struct MultiDraw
 {
     i32 primitive_count;
@@ -73,24 +160,101 @@ struct MultiDraw
     i32 *counts;
 };
 
+// One quad in the z = 0 plane, shader/quad.vert expands it to its corners
+struct QuadInstance
+{
+    V2 topleft;
+    V2 size;
+    // RGBA8, red in the lowest byte
+    u32 color;
+};
+
+// A contiguous range of the frame's quads, drawn with one instanced call
+struct QuadBatch
+{
+    u32 first;
+    u32 count;
+
+    // Union of the quads, the batch is culled as a whole
+    V2 bounds_min;
+    V2 bounds_max;
+};
+
 struct SingleDraw
 {
     i32 offset;
     i32 count;
 };
 
+// The tiles of one resident chunk. version changes whenever the tiles do, so
+// renderer side caches only rebuild what changed.
+struct LevelChunk
+{
+    i32 x;
+    i32 y;
+    u32 version;
+    u8 *tiles;
+};
+
+#define MAX_LEVEL_CHUNKS 64
+#define MAX_TILE_TYPES 16
+
+enum LevelRenderMode
+{
+    // Greedy meshed quads per chunk
+    LevelRender_Mesh,
+    // Tile index texture per chunk, one quad per chunk
+    LevelRender_Tilemap,
+    LevelRender_Count,
+};
+
+// Layers are drawn in order, within a layer the renderer orders commands to
+// minimize state changes
+enum RenderLayer
+{
+    RenderLayer_Level,
+    RenderLayer_World,
+    RenderLayer_Debug,
+    RenderLayer_Count,
+};
+
+enum RenderCommandType
+{
+    // The resident level chunks, see RenderData::level_chunks
+    RenderCommand_Level,
+    RenderCommand_Quads,
+    RenderCommand_Mesh,
+};
+
+// Only the payload of the command's type is used
+struct RenderCommand
+{
+    RenderCommandType type;
+    RenderLayer layer;
+
+    QuadBatch quads;
+
+    // Meshes with the same vao are drawn together as instances
+    Mesh mesh;
+    Mat4 transform;
+    // RGBA8, multiplies the mesh colors
+    u32 tint;
+};
+
+#define MAX_RENDER_COMMANDS 1024
+
 struct RenderData
 {
-    MultiDraw debug;
-    MultiDraw level;
-    MultiDraw entities;
-    MultiDraw player;
+    u32 command_count;
+    RenderCommand commands[MAX_RENDER_COMMANDS];
 
-    u32 vertex_count;
-    Vertex *vertex_buffer;
+    u32 level_chunk_count;
+    LevelChunk *level_chunks;
+    V3 tile_colors[MAX_TILE_TYPES];
+    LevelRenderMode level_mode;
 
-    u32 mesh_count;
-    Mesh meshes[16];
+    // Top down orthographic camera, draws the level from a cached texture
+    bool orthographic;
 
     V3 camera_pos;
     V3 camera_forward;
@@ -99,7 +263,12 @@ struct RenderData
 struct GameAssets
 {
     Mesh alien;
+
+    // Node transforms of the imported fbx scene
+    TransformHierarchy scene;
+    u32 alien_node;
 };
 
-typedef RenderData *GameUpdateCall(GameInput *input, GameAssets *assets, u8 *memory);
-typedef void GameInitializeCall(u8 *memory, u64 memory_size);
+typedef RenderData *GameUpdateCall(GameInput *input, GameAssets *assets, PlatformApi *platform, u8 *memory);
+typedef void GameInitializeCall(PlatformApi *platform, u8 *memory, u64 memory_size);
+typedef void GameShutdownCall(PlatformApi *platform, u8 *memory);
@@ -0,0 +1,268 @@
+#include "profiler.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+Profiler profiler = {};
+
+// Counters...
+//
+
+#ifdef __linux__
+
+struct PerfEventDesc
+{
+    u32 type;
+    u64 config;
+};
+
+PerfEventDesc perf_events[ProfileCounter_Count] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+i32 OpenPerfEvent(PerfEventDesc *desc, i32 group_fd)
+{
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = desc->type;
+    attr.config = desc->config;
+    attr.disabled = group_fd == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+void OpenCounters()
+{
+    for (u32 i = 0; i < ProfileCounter_Count; ++i)
+    {
+        profiler.counter_fds[i] = -1;
+    }
+
+    // Cycles lead the group. Without them the other counters are useless.
+    profiler.group_fd = OpenPerfEvent(&perf_events[ProfileCounter_Cycles], -1);
+    if (profiler.group_fd == -1)
+    {
+        printf("Profiler: perf_event_open failed, hardware counters disabled\n");
+        return;
+    }
+    profiler.counter_fds[ProfileCounter_Cycles] = profiler.group_fd;
+
+    for (u32 i = ProfileCounter_Cycles + 1; i < ProfileCounter_Count; ++i)
+    {
+        // Not every cpu (or vm) exposes every cache event. Missing ones read as zero.
+        profiler.counter_fds[i] = OpenPerfEvent(&perf_events[i], profiler.group_fd);
+    }
+
+    for (u32 i = 0; i < ProfileCounter_Count; ++i)
+    {
+        if (profiler.counter_fds[i] != -1)
+        {
+            ioctl(profiler.counter_fds[i], PERF_EVENT_IOC_ID, &profiler.counter_ids[i]);
+        }
+    }
+
+    ioctl(profiler.group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(profiler.group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    profiler.counters_enabled = true;
+}
+
+void CloseCounters()
+{
+    for (u32 i = 0; i < ProfileCounter_Count; ++i)
+    {
+        if (profiler.counter_fds[i] != -1)
+        {
+            close(profiler.counter_fds[i]);
+            profiler.counter_fds[i] = -1;
+        }
+    }
+    profiler.counters_enabled = false;
+}
+
+void ReadCounters(u64 *counters)
+{
+    // PERF_FORMAT_GROUP | PERF_FORMAT_ID: nr, then (value, id) per event
+    u64 data[1 + 2 * ProfileCounter_Count];
+    if (read(profiler.group_fd, data, sizeof(data)) <= 0)
+    {
+        return;
+    }
+
+    u64 count = data[0];
+    for (u64 j = 0; j < count; ++j)
+    {
+        u64 value = data[1 + 2 * j];
+        u64 id = data[2 + 2 * j];
+        for (u32 i = 0; i < ProfileCounter_Count; ++i)
+        {
+            if (profiler.counter_fds[i] != -1 && profiler.counter_ids[i] == id)
+            {
+                counters[i] = value;
+            }
+        }
+    }
+}
+
+#endif
+
+// Zones...
+//
+
+u64 ReadTimeNs()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = {};
+    if (!frequency.QuadPart)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (u64) ((f64) counter.QuadPart / (f64) frequency.QuadPart * 1e9);
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64) ts.tv_sec * 1000000000ull + (u64) ts.tv_nsec;
+#endif
+}
+
+void InitializeProfiler()
+{
+    profiler = {};
+    profiler.group_fd = -1;
+
+#if defined(PROFILE_COUNTERS) && defined(__linux__)
+    OpenCounters();
+#elif defined(PROFILE_COUNTERS) && defined(_WIN32)
+    profiler.thread_cycles_enabled = true;
+#endif
+}
+
+void ShutdownProfiler()
+{
+#ifdef __linux__
+    if (profiler.counters_enabled)
+    {
+        CloseCounters();
+    }
+#endif
+}
+
+ProfileSample TakeProfileSample()
+{
+    ProfileSample sample = {};
+
+#ifdef __linux__
+    if (profiler.counters_enabled)
+    {
+        ReadCounters(sample.counters);
+    }
+#elif defined(_WIN32)
+    if (profiler.thread_cycles_enabled)
+    {
+        ULONG64 cycles = 0;
+        QueryThreadCycleTime(GetCurrentThread(), &cycles);
+        sample.counters[ProfileCounter_Cycles] = cycles;
+    }
+#endif
+
+    sample.time_ns = ReadTimeNs();
+    return sample;
+}
+
+void RecordZone(u32 zone_index, const char *name, ProfileSample *start)
+{
+    ProfileSample end = TakeProfileSample();
+
+    assert(zone_index < lengthof(profiler.zones));
+    ProfileZone *zone = &profiler.zones[zone_index];
+    zone->name = name;
+    zone->hit_count++;
+    zone->elapsed_ns += end.time_ns - start->time_ns;
+
+    for (u32 i = 0; i < ProfileCounter_Count; ++i)
+    {
+        zone->counters[i] += end.counters[i] - start->counters[i];
+    }
+
+    if (zone_index >= profiler.zone_count)
+    {
+        profiler.zone_count = zone_index + 1;
+    }
+}
+
+inline f64 PerKiloInstruction(u64 count, u64 instructions)
+{
+    return instructions ? (f64) count * 1000.0 / (f64) instructions : 0;
+}
+
+void PrintProfile()
+{
+    printf("Profile:\n");
+
+    for (u32 i = 0; i < profiler.zone_count; ++i)
+    {
+        ProfileZone *zone = &profiler.zones[i];
+        if (!zone->hit_count)
+        {
+            continue;
+        }
+
+        f64 total_ms = (f64) zone->elapsed_ns / 1e6;
+        printf("  %-16s %6llu hits %10.3f ms total %8.3f ms avg",
+               zone->name,
+               (unsigned long long) zone->hit_count,
+               total_ms,
+               total_ms / zone->hit_count);
+
+        if (profiler.counters_enabled)
+        {
+            u64 cycles = zone->counters[ProfileCounter_Cycles];
+            u64 instructions = zone->counters[ProfileCounter_Instructions];
+            f64 ipc = cycles ? (f64) instructions / (f64) cycles : 0;
+
+            printf(" | IPC %.2f, per 1k instr: L1D miss %.2f, LLC miss %.2f, branch miss %.2f",
+                   ipc,
+                   PerKiloInstruction(zone->counters[ProfileCounter_L1DMisses], instructions),
+                   PerKiloInstruction(zone->counters[ProfileCounter_LLCMisses], instructions),
+                   PerKiloInstruction(zone->counters[ProfileCounter_BranchMisses], instructions));
+        }
+        else if (profiler.thread_cycles_enabled)
+        {
+            printf(" | %.3f Mcycles", (f64) zone->counters[ProfileCounter_Cycles] / 1e6);
+        }
+
+        printf("\n");
+    }
+}
+
+void ResetProfile()
+{
+    for (u32 i = 0; i < profiler.zone_count; ++i)
+    {
+        ProfileZone *zone = &profiler.zones[i];
+        const char *name = zone->name;
+        *zone = {};
+        zone->name = name;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "defines.h"
+
+// Scoped timing zones, compiled in with PROFILE (a Makefile and CMake option).
+// Every zone records wall time. With PROFILE_COUNTERS, zones also read counters
+// at their boundaries:
+// - Linux: perf_event_open hardware counters, so we get IPC and cache miss rates.
+// - Windows: only the thread's cycles through QueryThreadCycleTime. Instruction
+//   and cache counters need a kernel driver there, so they stay zero.
+
+enum ProfileCounter
+{
+    ProfileCounter_Cycles,
+    ProfileCounter_Instructions,
+    ProfileCounter_L1DMisses,
+    ProfileCounter_LLCMisses,
+    ProfileCounter_BranchMisses,
+    ProfileCounter_Count,
+};
+
+struct ProfileSample
+{
+    u64 time_ns;
+    u64 counters[ProfileCounter_Count];
+};
+
+struct ProfileZone
+{
+    const char *name;
+    u64 hit_count;
+    u64 elapsed_ns;
+    u64 counters[ProfileCounter_Count];
+};
+
+struct Profiler
+{
+    // All of ProfileCounter through perf_event_open
+    bool counters_enabled;
+    // Just ProfileCounter_Cycles
+    bool thread_cycles_enabled;
+    i32 group_fd;
+    i32 counter_fds[ProfileCounter_Count];
+    u64 counter_ids[ProfileCounter_Count];
+
+    u32 zone_count;
+    ProfileZone zones[64];
+};
+
+void InitializeProfiler();
+void ShutdownProfiler();
+ProfileSample TakeProfileSample();
+void RecordZone(u32 zone_index, const char *name, ProfileSample *start);
+void PrintProfile();
+void ResetProfile();
+
+struct ProfileScope
+{
+    u32 zone_index;
+    const char *name;
+    ProfileSample start;
+
+    ProfileScope(u32 zone_index, const char *name)
+    {
+        this->zone_index = zone_index;
+        this->name = name;
+        start = TakeProfileSample();
+    }
+
+    ~ProfileScope()
+    {
+        RecordZone(zone_index, name, &start);
+    }
+};
+
+#define ProfileJoin2(a, b) a##b
+#define ProfileJoin(a, b) ProfileJoin2(a, b)
+
+#ifdef PROFILE
+#define TimeBlock(name) ProfileScope ProfileJoin(profile_scope_, __LINE__)(__COUNTER__, name)
+#else
+#define TimeBlock(name)
+#endif
+
+#define TimeFunction TimeBlock(__func__)
@@ -0,0 +1,64 @@
+#include "radix_sort.h"
+
+#include <string.h>
+
+void RadixSort(u64 *keys, u32 *values, u32 count, Arena *arena)
+{
+    // One histogram per digit, all filled in a single pass
+    u32 (*histograms)[256] = (u32 (*)[256]) PushArrayZero(arena, u32, 256 * 8);
+    for (u32 i = 0; i < count; ++i)
+    {
+        u64 key = keys[i];
+        for (u32 digit = 0; digit < 8; ++digit)
+        {
+            histograms[digit][(key >> (digit * 8)) & 0xff]++;
+        }
+    }
+
+    u64 *src_keys = keys;
+    u32 *src_values = values;
+    u64 *dst_keys = PushArray(arena, u64, count);
+    u32 *dst_values = PushArray(arena, u32, count);
+
+    for (u32 digit = 0; digit < 8; ++digit)
+    {
+        u32 *histogram = histograms[digit];
+        u32 shift = digit * 8;
+
+        if (count == 0 || histogram[(src_keys[0] >> shift) & 0xff] == count)
+        {
+            continue;
+        }
+
+        // Histogram to start offsets
+        u32 offset = 0;
+        for (u32 bucket = 0; bucket < 256; ++bucket)
+        {
+            u32 bucket_count = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucket_count;
+        }
+
+        for (u32 i = 0; i < count; ++i)
+        {
+            u32 bucket = (src_keys[i] >> shift) & 0xff;
+            u32 destination = histogram[bucket]++;
+            dst_keys[destination] = src_keys[i];
+            dst_values[destination] = src_values[i];
+        }
+
+        u64 *swap_keys = src_keys;
+        src_keys = dst_keys;
+        dst_keys = swap_keys;
+
+        u32 *swap_values = src_values;
+        src_values = dst_values;
+        dst_values = swap_values;
+    }
+
+    if (src_keys != keys)
+    {
+        memcpy(keys, src_keys, sizeof(u64) * count);
+        memcpy(values, src_values, sizeof(u32) * count);
+    }
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "defines.h"
+#include "memory.h"
+
+// Stable least significant digit radix sort of 64 bit keys, 8 bits per pass.
+// values are moved along with their keys. Passes over a digit that every key
+// shares are skipped, so keys that only use a few fields stay cheap.
+void RadixSort(u64 *keys, u32 *values, u32 count, Arena *arena);
@@ -3,8 +3,12 @@
 #include "defines.h"
 #include "platform.h"
 
-void InitializeRenderer();
+void InitializeRenderer(PlatformApi *platform);
+// Recompiles shaders whose files changed in the background, swapping each one in once it is ready
+void ReloadShaders();
+// Waits until the gpu is done with the next frame region and returns it for the game to write
+QuadInstance *BeginFrame(u32 *quad_capacity);
 void DrawFrame(RenderData *render_data, i32 window_width, i32 window_height);
 void DoFbxTesting();
 
-Mesh CreateMesh(Vertex *vertices, u32  vertex_count, u32 *indices, u32 index_count);
+Mesh CreateMesh(PackedVertex *vertices, u32 vertex_count, u32 *indices, u32 index_count);
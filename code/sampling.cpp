@@ -0,0 +1,287 @@
+#include "sampling.h"
+
+#include <assert.h>
+
+// Tables...
+//
+
+#define HALTON_BASE3_DIGITS 21 // 3^21 > 2^32
+#define HALTON_BASE5_DIGITS 14 // 5^14 > 2^32
+
+struct RadicalInverseTables
+{
+    // Bit reversal of every byte
+    u8 reversed_bits[256];
+    // Every 5 digit base 3 number (3^5 = 243) with its digits reversed
+    u8 reversed_trits[243];
+
+    u64 powers3[HALTON_BASE3_DIGITS + 1];
+    u64 powers5[HALTON_BASE5_DIGITS + 1];
+
+    constexpr RadicalInverseTables() : reversed_bits(), reversed_trits(), powers3(), powers5()
+    {
+        for (u32 i = 0; i < 256; ++i)
+        {
+            u32 reversed = 0;
+            for (u32 bit = 0; bit < 8; ++bit)
+            {
+                reversed |= ((i >> bit) & 1) << (7 - bit);
+            }
+            reversed_bits[i] = reversed;
+        }
+
+        for (u32 i = 0; i < 243; ++i)
+        {
+            u32 value = i;
+            u32 reversed = 0;
+            for (u32 digit = 0; digit < 5; ++digit)
+            {
+                reversed = reversed * 3 + value % 3;
+                value /= 3;
+            }
+            reversed_trits[i] = reversed;
+        }
+
+        powers3[0] = 1;
+        for (u32 i = 1; i <= HALTON_BASE3_DIGITS; ++i)
+        {
+            powers3[i] = powers3[i - 1] * 3;
+        }
+
+        powers5[0] = 1;
+        for (u32 i = 1; i <= HALTON_BASE5_DIGITS; ++i)
+        {
+            powers5[i] = powers5[i - 1] * 5;
+        }
+    }
+};
+
+constexpr RadicalInverseTables radical_tables = RadicalInverseTables();
+
+// Largest float below 1
+#define ONE_MINUS_EPSILON 0.99999994f
+
+inline f32 FixedToUnit(u32 fixed)
+{
+    // Keep the top 24 bits so the conversion is exact and never rounds up to 1
+    return (f32) (fixed >> 8) * (1.0f / 16777216.0f);
+}
+
+// Random access...
+//
+
+f32 RadicalInverse2(u32 i)
+{
+    const u8 *table = radical_tables.reversed_bits;
+    u32 reversed = ((u32) table[i & 0xff] << 24) |
+                   ((u32) table[(i >> 8) & 0xff] << 16) |
+                   ((u32) table[(i >> 16) & 0xff] << 8) |
+                   ((u32) table[i >> 24]);
+    return FixedToUnit(reversed);
+}
+
+f32 RadicalInverse3(u32 i)
+{
+    // Five base 3 digits per lookup, so a u32 needs at most 5 of them
+    f64 result = 0;
+    f64 scale = 1.0 / 243.0;
+    while (i > 0)
+    {
+        result += radical_tables.reversed_trits[i % 243] * scale;
+        scale *= 1.0 / 243.0;
+        i /= 243;
+    }
+
+    return Min(result, ONE_MINUS_EPSILON);
+}
+
+f32 Halton(u32 i, u32 b)
+{
+    if (b == 2)
+    {
+        return RadicalInverse2(i);
+    }
+    if (b == 3)
+    {
+        return RadicalInverse3(i);
+    }
+
+    f64 inv_base = 1.0 / b;
+    f64 f = 1;
+    f64 r = 0;
+    while (i > 0) {
+        f *= inv_base;
+        r += f * (i % b);
+        i /= b;
+    }
+
+    return Min(r, ONE_MINUS_EPSILON);
+}
+
+// Incremental Halton...
+//
+
+HaltonDigits BeginDigits(u32 index, u32 base, const u64 *powers, u32 digit_count)
+{
+    HaltonDigits result = {};
+    for (u32 k = 0; k < digit_count && index > 0; ++k)
+    {
+        result.digits[k] = index % base;
+        result.reversed += result.digits[k] * powers[digit_count - 1 - k];
+        index /= base;
+    }
+    return result;
+}
+
+inline void IncrementDigits(HaltonDigits *d, u32 base, const u64 *powers, u32 digit_count)
+{
+    // Carries happen with probability 1/base per digit, so this is O(1) on average
+    for (u32 k = 0; k < digit_count; ++k)
+    {
+        u64 place = powers[digit_count - 1 - k];
+        if (d->digits[k] + 1u < base)
+        {
+            d->digits[k]++;
+            d->reversed += place;
+            return;
+        }
+
+        d->digits[k] = 0;
+        d->reversed -= (base - 1) * place;
+    }
+}
+
+inline f32 DigitsToUnit(HaltonDigits *d, f64 inv_scale)
+{
+    return Min(d->reversed * inv_scale, ONE_MINUS_EPSILON);
+}
+
+HaltonSequence BeginHalton(u32 start_index)
+{
+    HaltonSequence sequence = {};
+    sequence.index = start_index;
+    sequence.base3 = BeginDigits(start_index, 3, radical_tables.powers3, HALTON_BASE3_DIGITS);
+    sequence.base5 = BeginDigits(start_index, 5, radical_tables.powers5, HALTON_BASE5_DIGITS);
+    return sequence;
+}
+
+inline void AdvanceHalton(HaltonSequence *sequence)
+{
+    sequence->index++;
+    IncrementDigits(&sequence->base3, 3, radical_tables.powers3, HALTON_BASE3_DIGITS);
+    IncrementDigits(&sequence->base5, 5, radical_tables.powers5, HALTON_BASE5_DIGITS);
+}
+
+V2 NextHalton2D(HaltonSequence *sequence)
+{
+    V2 result;
+    result.x = RadicalInverse2(sequence->index);
+    result.y = DigitsToUnit(&sequence->base3, 1.0 / radical_tables.powers3[HALTON_BASE3_DIGITS]);
+    AdvanceHalton(sequence);
+    return result;
+}
+
+V3 NextHalton3D(HaltonSequence *sequence)
+{
+    V3 result;
+    result.x = RadicalInverse2(sequence->index);
+    result.y = DigitsToUnit(&sequence->base3, 1.0 / radical_tables.powers3[HALTON_BASE3_DIGITS]);
+    result.z = DigitsToUnit(&sequence->base5, 1.0 / radical_tables.powers5[HALTON_BASE5_DIGITS]);
+    AdvanceHalton(sequence);
+    return result;
+}
+
+V2 *FillHalton2D(Arena *arena, HaltonSequence *sequence, u32 count)
+{
+    V2 *samples = PushArray(arena, V2, count);
+    for (u32 i = 0; i < count; ++i)
+    {
+        samples[i] = NextHalton2D(sequence);
+    }
+    return samples;
+}
+
+V3 *FillHalton3D(Arena *arena, HaltonSequence *sequence, u32 count)
+{
+    V3 *samples = PushArray(arena, V3, count);
+    for (u32 i = 0; i < count; ++i)
+    {
+        samples[i] = NextHalton3D(sequence);
+    }
+    return samples;
+}
+
+// R2 / R3...
+//
+
+// 1/g^k as 0.32 fixed point, g being the plastic number for R2 and the
+// root of x^4 = x + 1 for R3
+#define R2_STEP_X 0xc13fa9a9u
+#define R2_STEP_Y 0x91e10da5u
+#define R3_STEP_X 0xd1b54a32u
+#define R3_STEP_Y 0xabc98388u
+#define R3_STEP_Z 0x8cb92ba7u
+
+RSequence BeginR(u32 start_index, u32 step_x, u32 step_y, u32 step_z)
+{
+    RSequence sequence = {};
+    sequence.step[0] = step_x;
+    sequence.step[1] = step_y;
+    sequence.step[2] = step_z;
+
+    // Offset by 0.5 like the reference sequence, u32 overflow is the fractional part
+    for (u32 i = 0; i < 3; ++i)
+    {
+        sequence.state[i] = 0x80000000u + start_index * sequence.step[i];
+    }
+    return sequence;
+}
+
+RSequence BeginR2(u32 start_index)
+{
+    return BeginR(start_index, R2_STEP_X, R2_STEP_Y, 0);
+}
+
+RSequence BeginR3(u32 start_index)
+{
+    return BeginR(start_index, R3_STEP_X, R3_STEP_Y, R3_STEP_Z);
+}
+
+V2 NextR2(RSequence *sequence)
+{
+    V2 result = v2(FixedToUnit(sequence->state[0]), FixedToUnit(sequence->state[1]));
+    sequence->state[0] += sequence->step[0];
+    sequence->state[1] += sequence->step[1];
+    return result;
+}
+
+V3 NextR3(RSequence *sequence)
+{
+    V3 result = v3(FixedToUnit(sequence->state[0]),
+                   FixedToUnit(sequence->state[1]),
+                   FixedToUnit(sequence->state[2]));
+    sequence->state[0] += sequence->step[0];
+    sequence->state[1] += sequence->step[1];
+    sequence->state[2] += sequence->step[2];
+    return result;
+}
+
+V2 *FillR2(Arena *arena, RSequence *sequence, u32 count)
+{
+    V2 *samples = PushArray(arena, V2, count);
+    for (u32 i = 0; i < count; ++i)
+    {
+        samples[i] = NextR2(sequence);
+    }
+    return samples;
+}
+
+V3 *FillR3(Arena *arena, RSequence *sequence, u32 count)
+{
+    V3 *samples = PushArray(arena, V3, count);
+    for (u32 i = 0; i < count; ++i)
+    {
+        samples[i] = NextR3(sequence);
+    }
+    return samples;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "defines.h"
+#include "game_math.h"
+#include "memory.h"
+
+// Low discrepancy sequences for spawn scattering, jitter and procedural generation.
+//
+// All values are in [0, 1). Halton uses bases 2, 3 (and 5 for the third
+// dimension). R2/R3 are the additive recurrences on the plastic number
+// generalizations, which are cheaper still and do not correlate across dimensions.
+
+// Random access, table driven
+f32 RadicalInverse2(u32 i);
+f32 RadicalInverse3(u32 i);
+f32 Halton(u32 i, u32 b);
+
+// Incremental Halton. Next* returns the sample for the current index and advances
+// it in amortized O(1) by carrying digits instead of dividing.
+
+#define HALTON_MAX_DIGITS 21
+
+struct HaltonDigits
+{
+    // The digits reversed around the decimal point, as an integer of digit_count digits
+    u64 reversed;
+    u8 digits[HALTON_MAX_DIGITS];
+};
+
+struct HaltonSequence
+{
+    u32 index;
+    HaltonDigits base3;
+    HaltonDigits base5;
+};
+
+HaltonSequence BeginHalton(u32 start_index);
+V2 NextHalton2D(HaltonSequence *sequence);
+V3 NextHalton3D(HaltonSequence *sequence);
+V2 *FillHalton2D(Arena *arena, HaltonSequence *sequence, u32 count);
+V3 *FillHalton3D(Arena *arena, HaltonSequence *sequence, u32 count);
+
+// R2/R3. The state is 0.32 fixed point, so stepping wraps for free and never drifts.
+
+struct RSequence
+{
+    u32 state[3];
+    u32 step[3];
+};
+
+RSequence BeginR2(u32 start_index);
+RSequence BeginR3(u32 start_index);
+V2 NextR2(RSequence *sequence);
+V3 NextR3(RSequence *sequence);
+V2 *FillR2(Arena *arena, RSequence *sequence, u32 count);
+V3 *FillR3(Arena *arena, RSequence *sequence, u32 count);
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "defines.h"
+#include "game_math.h"
+
+// Arrays fed to lane kernels are padded to BATCH_WIDTH (the widest lane count)
+// and 32 byte aligned, so kernels never need a scalar tail.
+#define BATCH_WIDTH 8
+
+inline u32 BatchPadded(u32 count)
+{
+    return (count + BATCH_WIDTH - 1) & ~(BATCH_WIDTH - 1);
+}
+
+// Thin wrappers so every kernel is written once and compiles to 8 wide AVX,
+// 4 wide SSE or plain scalar code depending on the math configuration.
+// Compare results are lane masks; LaneMask packs them into one bit per lane.
+
+#if defined(MATH_AVX)
+
+#define LANE_WIDTH 8
+typedef __m256 Lane;
+
+inline Lane LaneLoad(f32 *p) { return _mm256_load_ps(p); }
+inline Lane LaneLoadUnaligned(f32 *p) { return _mm256_loadu_ps(p); }
+inline void LaneStore(f32 *p, Lane a) { _mm256_store_ps(p, a); }
+inline Lane LaneSet(f32 a) { return _mm256_set1_ps(a); }
+inline Lane LaneIndices() { return _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7); }
+inline Lane LaneAdd(Lane a, Lane b) { return _mm256_add_ps(a, b); }
+inline Lane LaneSub(Lane a, Lane b) { return _mm256_sub_ps(a, b); }
+inline Lane LaneMul(Lane a, Lane b) { return _mm256_mul_ps(a, b); }
+inline Lane LaneDiv(Lane a, Lane b) { return _mm256_div_ps(a, b); }
+inline Lane LaneSqrt(Lane a) { return _mm256_sqrt_ps(a); }
+inline Lane LaneMin(Lane a, Lane b) { return _mm256_min_ps(a, b); }
+inline Lane LaneMax(Lane a, Lane b) { return _mm256_max_ps(a, b); }
+inline Lane LaneAnd(Lane a, Lane b) { return _mm256_and_ps(a, b); }
+inline Lane LaneTrue() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+inline Lane LaneGreaterEqual(Lane a, Lane b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+inline Lane LaneLessEqual(Lane a, Lane b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+inline Lane LaneGreater(Lane a, Lane b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+inline Lane LaneLess(Lane a, Lane b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline u32 LaneMask(Lane a) { return _mm256_movemask_ps(a); }
+
+inline f32 LaneSum(Lane a)
+{
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+#elif defined(MATH_SSE)
+
+#define LANE_WIDTH 4
+typedef __m128 Lane;
+
+inline Lane LaneLoad(f32 *p) { return _mm_load_ps(p); }
+inline Lane LaneLoadUnaligned(f32 *p) { return _mm_loadu_ps(p); }
+inline void LaneStore(f32 *p, Lane a) { _mm_store_ps(p, a); }
+inline Lane LaneSet(f32 a) { return _mm_set1_ps(a); }
+inline Lane LaneIndices() { return _mm_setr_ps(0, 1, 2, 3); }
+inline Lane LaneAdd(Lane a, Lane b) { return _mm_add_ps(a, b); }
+inline Lane LaneSub(Lane a, Lane b) { return _mm_sub_ps(a, b); }
+inline Lane LaneMul(Lane a, Lane b) { return _mm_mul_ps(a, b); }
+inline Lane LaneDiv(Lane a, Lane b) { return _mm_div_ps(a, b); }
+inline Lane LaneSqrt(Lane a) { return _mm_sqrt_ps(a); }
+inline Lane LaneMin(Lane a, Lane b) { return _mm_min_ps(a, b); }
+inline Lane LaneMax(Lane a, Lane b) { return _mm_max_ps(a, b); }
+inline Lane LaneAnd(Lane a, Lane b) { return _mm_and_ps(a, b); }
+inline Lane LaneTrue() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+inline Lane LaneGreaterEqual(Lane a, Lane b) { return _mm_cmpge_ps(a, b); }
+inline Lane LaneLessEqual(Lane a, Lane b) { return _mm_cmple_ps(a, b); }
+inline Lane LaneGreater(Lane a, Lane b) { return _mm_cmpgt_ps(a, b); }
+inline Lane LaneLess(Lane a, Lane b) { return _mm_cmplt_ps(a, b); }
+inline u32 LaneMask(Lane a) { return _mm_movemask_ps(a); }
+
+inline f32 LaneSum(Lane a)
+{
+    __m128 sum = _mm_add_ps(a, _mm_movehl_ps(a, a));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+#else
+
+#define LANE_WIDTH 1
+typedef f32 Lane;
+
+inline Lane LaneLoad(f32 *p) { return *p; }
+inline Lane LaneLoadUnaligned(f32 *p) { return *p; }
+inline void LaneStore(f32 *p, Lane a) { *p = a; }
+inline Lane LaneSet(f32 a) { return a; }
+inline Lane LaneAdd(Lane a, Lane b) { return a + b; }
+inline Lane LaneSub(Lane a, Lane b) { return a - b; }
+inline Lane LaneMul(Lane a, Lane b) { return a * b; }
+inline Lane LaneDiv(Lane a, Lane b) { return a / b; }
+inline Lane LaneSqrt(Lane a) { return Sqrt(a); }
+inline Lane LaneMin(Lane a, Lane b) { return Min(a, b); }
+inline Lane LaneMax(Lane a, Lane b) { return Max(a, b); }
+
+#endif
+
+// Appends base + lane for every set lane of a LaneMask, skipping padding lanes at or past count
+inline u32 AppendLaneIndices(u32 mask, u32 base, u32 count, u32 *indices, u32 index_count)
+{
+    while (mask)
+    {
+        u32 lane = CountTrailingZeros(mask);
+        mask &= mask - 1;
+
+        if (base + lane < count)
+        {
+            indices[index_count++] = base + lane;
+        }
+    }
+    return index_count;
+}
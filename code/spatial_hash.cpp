@@ -0,0 +1,295 @@
+#include "spatial_hash.h"
+
+#include <assert.h>
+#include <string.h>
+
+SpatialHash PushSpatialHash(Arena *arena, u32 capacity, u32 cell_count, f32 cell_size)
+{
+    assert(cell_count && (cell_count & (cell_count - 1)) == 0);
+
+    SpatialHash hash = {};
+    hash.cell_size = cell_size;
+    hash.inv_cell_size = 1 / cell_size;
+    hash.cell_count = cell_count;
+    hash.cell_start = PushArrayZero(arena, u32, cell_count + 1);
+    hash.capacity = capacity;
+    hash.item_cells = PushArray(arena, u32, capacity);
+    hash.ids = PushArray(arena, u32, capacity);
+    // Slack so lane loads can run past the end of the last range
+    hash.x = PushArrayZero(arena, f32, capacity + BATCH_WIDTH);
+    hash.y = PushArrayZero(arena, f32, capacity + BATCH_WIDTH);
+    return hash;
+}
+
+inline u32 CellIndex(SpatialHash *hash, i32 cell_x, i32 cell_y)
+{
+    u32 key = (u32) cell_x * 0x8da6b343 ^ (u32) cell_y * 0xd8163841;
+    return (key ^ (key >> 16)) & (hash->cell_count - 1);
+}
+
+void BuildSpatialHash(SpatialHash *hash, V2Batch *positions)
+{
+    u32 count = positions->count;
+    assert(count <= hash->capacity);
+    hash->count = count;
+
+    // Count, shifted by one so the prefix sum below lands on the start offsets
+    u32 *cell_start = hash->cell_start;
+    memset(cell_start, 0, sizeof(u32) * (hash->cell_count + 1));
+
+    for (u32 i = 0; i < count; ++i)
+    {
+        i32 cell_x = CellCoordinate(hash, positions->x[i]);
+        i32 cell_y = CellCoordinate(hash, positions->y[i]);
+        u32 cell = CellIndex(hash, cell_x, cell_y);
+        hash->item_cells[i] = cell;
+        cell_start[cell + 1]++;
+    }
+
+    for (u32 cell = 0; cell < hash->cell_count; ++cell)
+    {
+        cell_start[cell + 1] += cell_start[cell];
+    }
+
+    // Scatter. Uses cell_start[cell] as the write cursor, which leaves every
+    // entry pointing at the start of the next cell...
+    for (u32 i = 0; i < count; ++i)
+    {
+        u32 slot = cell_start[hash->item_cells[i]]++;
+        hash->ids[slot] = i;
+        hash->x[slot] = positions->x[i];
+        hash->y[slot] = positions->y[i];
+    }
+
+    // ...so shift back by one
+    for (u32 cell = hash->cell_count; cell > 0; --cell)
+    {
+        cell_start[cell] = cell_start[cell - 1];
+    }
+    cell_start[0] = 0;
+}
+
+u32 NeighbourCells(SpatialHash *hash, i32 center_x, i32 center_y, u32 *cells)
+{
+    u32 cell_count = 0;
+    for (i32 dy = -1; dy <= 1; ++dy)
+    {
+        for (i32 dx = -1; dx <= 1; ++dx)
+        {
+            u32 cell = CellIndex(hash, center_x + dx, center_y + dy);
+
+            bool seen = false;
+            for (u32 i = 0; i < cell_count && !seen; ++i)
+            {
+                seen = cells[i] == cell;
+            }
+
+            if (!seen)
+            {
+                cells[cell_count++] = cell;
+            }
+        }
+    }
+
+    return cell_count;
+}
+
+// Queries bigger than this many cells scan every item instead
+#define MAX_QUERY_CELLS 256
+
+// Writes the distinct table cells under the box. Returns 0 when the box is too
+// big to be worth it and every item should be scanned instead.
+static u32 GatherCells(SpatialHash *hash, V2 bl, V2 tr, u32 *cells)
+{
+    i32 min_x = CellCoordinate(hash, bl.x);
+    i32 min_y = CellCoordinate(hash, bl.y);
+    i32 max_x = CellCoordinate(hash, tr.x);
+    i32 max_y = CellCoordinate(hash, tr.y);
+
+    u64 area = (u64) (max_x - min_x + 1) * (u64) (max_y - min_y + 1);
+    if (area > MAX_QUERY_CELLS || area >= hash->cell_count)
+    {
+        return 0;
+    }
+
+    // Distant cells can collide in the table, their range must only be visited once
+    u32 cell_count = 0;
+    for (i32 cell_y = min_y; cell_y <= max_y; ++cell_y)
+    {
+        for (i32 cell_x = min_x; cell_x <= max_x; ++cell_x)
+        {
+            u32 cell = CellIndex(hash, cell_x, cell_y);
+
+            bool seen = false;
+            for (u32 i = 0; i < cell_count && !seen; ++i)
+            {
+                seen = cells[i] == cell;
+            }
+
+            if (!seen)
+            {
+                cells[cell_count++] = cell;
+            }
+        }
+    }
+
+    return cell_count;
+}
+
+// Box test always, circle test when radius_sq >= 0
+static IdList Query(SpatialHash *hash, Arena *arena, V2 bl, V2 tr, V2 center, f32 radius_sq)
+{
+    u32 cells[MAX_QUERY_CELLS];
+    u32 cell_count = GatherCells(hash, bl, tr, cells);
+
+    // Reserve the worst case, hand the rest back once the list is filled
+    u32 reserved = hash->count;
+    if (cell_count)
+    {
+        reserved = 0;
+        for (u32 i = 0; i < cell_count; ++i)
+        {
+            reserved += hash->cell_start[cells[i] + 1] - hash->cell_start[cells[i]];
+        }
+    }
+
+    IdList list = {};
+    list.ids = PushArray(arena, u32, reserved);
+
+    u32 range_count = cell_count ? cell_count : 1;
+    for (u32 range = 0; range < range_count; ++range)
+    {
+        u32 start = cell_count ? hash->cell_start[cells[range]] : 0;
+        u32 end = cell_count ? hash->cell_start[cells[range] + 1] : hash->count;
+
+        for (u32 i = start; i < end; ++i)
+        {
+            f32 x = hash->x[i];
+            f32 y = hash->y[i];
+            bool inside = x >= bl.x && x <= tr.x && y >= bl.y && y <= tr.y;
+
+            if (inside && radius_sq >= 0)
+            {
+                f32 dx = x - center.x;
+                f32 dy = y - center.y;
+                inside = dx * dx + dy * dy <= radius_sq;
+            }
+
+            if (inside)
+            {
+                list.ids[list.count++] = hash->ids[i];
+            }
+        }
+    }
+
+    // The list is the last allocation, so its unused tail can be popped
+    assert((u8 *) (list.ids + reserved) == arena->memory + arena->offset);
+    arena->offset -= sizeof(u32) * (reserved - list.count);
+
+    return list;
+}
+
+IdList QueryRadius(SpatialHash *hash, Arena *arena, V2 center, f32 radius)
+{
+    return Query(hash, arena, center - v2(radius), center + v2(radius), center, radius * radius);
+}
+
+IdList QueryAABB(SpatialHash *hash, Arena *arena, V2 bl, V2 tr)
+{
+    return Query(hash, arena, bl, tr, bl, -1);
+}
+
+// Insertion into the list sorted by distance, dropping the furthest when full
+static void InsertNearest(IdList *list, f32 *distances, u32 k, u32 id, f32 distance_sq)
+{
+    if (list->count == k && distance_sq >= distances[k - 1])
+    {
+        return;
+    }
+
+    // Colliding cells can visit the same item twice
+    for (u32 i = 0; i < list->count; ++i)
+    {
+        if (list->ids[i] == id)
+        {
+            return;
+        }
+    }
+
+    u32 i = list->count < k ? list->count++ : k - 1;
+    while (i > 0 && distances[i - 1] > distance_sq)
+    {
+        distances[i] = distances[i - 1];
+        list->ids[i] = list->ids[i - 1];
+        i--;
+    }
+    distances[i] = distance_sq;
+    list->ids[i] = id;
+}
+
+static void InsertRange(SpatialHash *hash, IdList *list, f32 *distances, u32 k,
+                        u32 start, u32 end, V2 center, f32 max_distance_sq)
+{
+    for (u32 i = start; i < end; ++i)
+    {
+        f32 x = hash->x[i] - center.x;
+        f32 y = hash->y[i] - center.y;
+        f32 distance_sq = x * x + y * y;
+
+        if (distance_sq <= max_distance_sq)
+        {
+            InsertNearest(list, distances, k, hash->ids[i], distance_sq);
+        }
+    }
+}
+
+IdList QueryNearest(SpatialHash *hash, Arena *arena, V2 center, u32 k, f32 max_radius)
+{
+    IdList list = {};
+    list.ids = PushArray(arena, u32, k);
+    if (!k || !hash->count)
+    {
+        return list;
+    }
+
+    TempMemory temp = ScratchAllocate();
+    f32 *distances = PushArray(temp.arena, f32, k);
+    f32 max_distance_sq = max_radius * max_radius;
+
+    f32 max_ring = max_radius * hash->inv_cell_size + 1;
+    if ((2 * max_ring + 1) * (2 * max_ring + 1) >= hash->cell_count)
+    {
+        // The rings would visit more cells than the table has
+        InsertRange(hash, &list, distances, k, 0, hash->count, center, max_distance_sq);
+    }
+    else
+    {
+        i32 center_x = CellCoordinate(hash, center.x);
+        i32 center_y = CellCoordinate(hash, center.y);
+
+        // Walk rings of cells outwards. Everything beyond ring r is at least
+        // r * cell_size away, which ends the search once k items are closer.
+        for (i32 ring = 0; ring <= (i32) max_ring; ++ring)
+        {
+            for (i32 dy = -ring; dy <= ring; ++dy)
+            {
+                i32 step = (dy == -ring || dy == ring) ? 1 : 2 * ring;
+                for (i32 dx = -ring; dx <= ring; dx += step)
+                {
+                    u32 cell = CellIndex(hash, center_x + dx, center_y + dy);
+                    InsertRange(hash, &list, distances, k, hash->cell_start[cell], hash->cell_start[cell + 1],
+                                center, max_distance_sq);
+                }
+            }
+
+            f32 reach = ring * hash->cell_size;
+            if (list.count == k && distances[k - 1] <= reach * reach)
+            {
+                break;
+            }
+        }
+    }
+
+    EndTempRegion(temp);
+    return list;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "defines.h"
+#include "game_math.h"
+#include "memory.h"
+#include "batch_math.h"
+
+// Uniform grid over an unbounded plane, hashed into a fixed number of cells.
+// Rebuilt every tick with a counting sort, so each cell's items end up in one
+// contiguous range of `ids` and queries only ever walk a few short ranges.
+// Cells that collide in the table share a range, queries filter by position.
+
+struct SpatialHash
+{
+    f32 cell_size;
+    f32 inv_cell_size;
+
+    // Power of two. cell_start has cell_count + 1 entries, cell i is
+    // ids[cell_start[i] .. cell_start[i + 1]).
+    u32 cell_count;
+    u32 *cell_start;
+
+    u32 count;
+    u32 capacity;
+    u32 *item_cells;
+
+    // Sorted by cell, positions copied along so queries never touch the source.
+    // x and y have BATCH_WIDTH entries of slack past capacity.
+    u32 *ids;
+    f32 *x;
+    f32 *y;
+};
+
+struct IdList
+{
+    u32 count;
+    u32 *ids;
+};
+
+inline i32 CellCoordinate(SpatialHash *hash, f32 a)
+{
+    return (i32) Floor(a * hash->inv_cell_size);
+}
+
+SpatialHash PushSpatialHash(Arena *arena, u32 capacity, u32 cell_count, f32 cell_size);
+
+// Item ids are the indices into positions
+void BuildSpatialHash(SpatialHash *hash, V2Batch *positions);
+
+// Writes the distinct table cells of the 3x3 block around a cell (at most 9) and
+// returns how many there are. Covers everything within cell_size of the cell.
+u32 NeighbourCells(SpatialHash *hash, i32 cell_x, i32 cell_y, u32 *cells);
+
+// Results are pushed to arena
+IdList QueryRadius(SpatialHash *hash, Arena *arena, V2 center, f32 radius);
+IdList QueryAABB(SpatialHash *hash, Arena *arena, V2 bl, V2 tr);
+// Up to k ids sorted by distance, nearest first. max_radius bounds the search.
+IdList QueryNearest(SpatialHash *hash, Arena *arena, V2 center, u32 k, f32 max_radius);
@@ -0,0 +1,408 @@
+#include "streaming.h"
+#include "sampling.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+// On disk layout of a saved chunk
+#define CHUNK_FILE_VERSION 2
+
+struct ChunkFile
+{
+    u32 version;
+    u32 enemy_count;
+    u32 tower_count;
+    f32 enemy_x[CHUNK_ENEMY_CAPACITY];
+    f32 enemy_y[CHUNK_ENEMY_CAPACITY];
+    f32 enemy_vel_x[CHUNK_ENEMY_CAPACITY];
+    f32 enemy_vel_y[CHUNK_ENEMY_CAPACITY];
+    f32 enemy_hp[CHUNK_ENEMY_CAPACITY];
+    EnemyState enemy_state[CHUNK_ENEMY_CAPACITY];
+    Tower towers[CHUNK_TOWER_CAPACITY];
+};
+
+// Copies the columns that persist, the per tick ones start out cleared
+#define CopyChunkColumns(to, from) \
+    memcpy((to)->enemy_x, (from)->enemy_x, sizeof((to)->enemy_x)); \
+    memcpy((to)->enemy_y, (from)->enemy_y, sizeof((to)->enemy_y)); \
+    memcpy((to)->enemy_vel_x, (from)->enemy_vel_x, sizeof((to)->enemy_vel_x)); \
+    memcpy((to)->enemy_vel_y, (from)->enemy_vel_y, sizeof((to)->enemy_vel_y)); \
+    memcpy((to)->enemy_hp, (from)->enemy_hp, sizeof((to)->enemy_hp)); \
+    memcpy((to)->enemy_state, (from)->enemy_state, sizeof((to)->enemy_state)); \
+    memcpy((to)->towers, (from)->towers, sizeof((to)->towers))
+
+void InitializeStreamer(ChunkStreamer *streamer, StreamConfig config)
+{
+    *streamer = {};
+    streamer->config = config;
+}
+
+inline void ChunkFilePath(char *path, u32 size, i32 chunk_x, i32 chunk_y)
+{
+    snprintf(path, size, "save/chunk_%d_%d.bin", chunk_x, chunk_y);
+}
+
+inline u32 ChunkHash(i32 chunk_x, i32 chunk_y)
+{
+    u32 hash = (u32) chunk_x * 0x8da6b343 ^ (u32) chunk_y * 0xd8163841;
+    hash ^= hash >> 15;
+    hash *= 0x2c1b3c6d;
+    hash ^= hash >> 12;
+    return hash;
+}
+
+// Deterministic, so unmodified chunks never need saving
+static void GenerateChunk(StreamJob *job)
+{
+    u32 hash = ChunkHash(job->chunk_x, job->chunk_y);
+
+    // Most of the map is empty
+    job->enemy_count = 0;
+    job->tower_count = 0;
+    if (hash % 8 != 0)
+    {
+        return;
+    }
+
+    job->enemy_count = 8 + (hash >> 8) % (CHUNK_ENEMY_CAPACITY - 8);
+
+    f32 chunk_pixels = CHUNK_SIZE * TILE_SIZE;
+    V2 origin = v2(job->chunk_x, job->chunk_y) * chunk_pixels;
+    HaltonSequence positions = BeginHalton(hash >> 16);
+    RSequence velocities = BeginR2(hash);
+
+    ChunkData *data = job->data;
+    for (u32 i = 0; i < job->enemy_count; ++i)
+    {
+        V2 position = origin + NextHalton2D(&positions) * chunk_pixels;
+        V2 velocity = (NextR2(&velocities) - v2(0.5)) * TILE_SIZE;
+        data->enemy_x[i] = position.x;
+        data->enemy_y[i] = position.y;
+        data->enemy_vel_x[i] = velocity.x;
+        data->enemy_vel_y[i] = velocity.y;
+        data->enemy_hp[i] = 10;
+        data->enemy_state[i] = EnemyState_Wander;
+    }
+}
+
+// data may be NULL for a chunk that has nothing left in it
+static void SaveChunk(PlatformApi *platform, i32 chunk_x, i32 chunk_y, u32 enemy_count, u32 tower_count, ChunkData *data)
+{
+    char path[64];
+    ChunkFilePath(path, sizeof(path), chunk_x, chunk_y);
+
+    ChunkFile file = {};
+    file.version = CHUNK_FILE_VERSION;
+    file.enemy_count = enemy_count;
+    file.tower_count = tower_count;
+    if (data)
+    {
+        CopyChunkColumns(&file, data);
+    }
+    platform->WriteFile(path, &file, sizeof(file));
+}
+
+// Runs on a worker thread
+static void DoStreamWork(void *data)
+{
+    StreamJob *job = (StreamJob *) data;
+    PlatformApi *platform = job->platform;
+
+    if (job->type == StreamJob_Load)
+    {
+        char path[64];
+        ChunkFilePath(path, sizeof(path), job->chunk_x, job->chunk_y);
+
+        ChunkFile file;
+        memset(job->data->enemy_damage, 0, sizeof(job->data->enemy_damage));
+        job->data->enemy_hurt = 0;
+
+        if (job->serialize &&
+            platform->ReadFileInto(path, &file, sizeof(file)) &&
+            file.version == CHUNK_FILE_VERSION)
+        {
+            job->enemy_count = file.enemy_count < CHUNK_ENEMY_CAPACITY ? file.enemy_count : CHUNK_ENEMY_CAPACITY;
+            job->tower_count = file.tower_count < CHUNK_TOWER_CAPACITY ? file.tower_count : CHUNK_TOWER_CAPACITY;
+            CopyChunkColumns(job->data, &file);
+        }
+        else
+        {
+            GenerateChunk(job);
+        }
+    }
+    else
+    {
+        SaveChunk(platform, job->chunk_x, job->chunk_y, job->enemy_count, job->tower_count, job->data);
+    }
+
+    CompletePreviousWrites();
+    job->done = 1;
+}
+
+static StreamJob *BeginJob(ChunkStreamer *streamer, PlatformApi *platform, StreamJobType type,
+                           i32 chunk_x, i32 chunk_y, ChunkData *data)
+{
+    for (u32 i = 0; i < MAX_STREAM_JOBS; ++i)
+    {
+        StreamJob *job = streamer->jobs + i;
+        if (!job->in_use)
+        {
+            *job = {};
+            job->in_use = true;
+            job->type = type;
+            job->chunk_x = chunk_x;
+            job->chunk_y = chunk_y;
+            job->data = data;
+            job->platform = platform;
+            job->serialize = streamer->config.serialize;
+            return job;
+        }
+    }
+
+    return NULL;
+}
+
+static bool HasFreeJob(ChunkStreamer *streamer)
+{
+    for (u32 i = 0; i < MAX_STREAM_JOBS; ++i)
+    {
+        if (!streamer->jobs[i].in_use)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// A chunk must not be read back while its save is still being written
+static bool IsSaving(ChunkStreamer *streamer, i32 chunk_x, i32 chunk_y)
+{
+    for (u32 i = 0; i < MAX_STREAM_JOBS; ++i)
+    {
+        StreamJob *job = streamer->jobs + i;
+        if (job->in_use && job->type == StreamJob_Save && job->chunk_x == chunk_x && job->chunk_y == chunk_y)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void FinishJob(World *world, StreamJob *job)
+{
+    CompletePreviousReads();
+
+    if (job->type == StreamJob_Load)
+    {
+        // Loading chunks are never evicted
+        Chunk *chunk = GetChunk(world, job->chunk_x, job->chunk_y);
+        assert(chunk && (chunk->flags & ChunkFlag_Loading));
+
+        chunk->flags &= ~ChunkFlag_Loading;
+        chunk->enemy_count = job->enemy_count;
+        chunk->tower_count = job->tower_count;
+
+        if (chunk->enemy_count || chunk->tower_count)
+        {
+            chunk->data = job->data;
+        }
+        else
+        {
+            ReleaseChunkData(world, job->data);
+        }
+    }
+    else
+    {
+        ReleaseChunkData(world, job->data);
+    }
+
+    job->in_use = false;
+}
+
+static void FinishCompletedJobs(ChunkStreamer *streamer, World *world)
+{
+    for (u32 i = 0; i < MAX_STREAM_JOBS; ++i)
+    {
+        StreamJob *job = streamer->jobs + i;
+        if (job->in_use && job->done)
+        {
+            FinishJob(world, job);
+        }
+    }
+}
+
+static bool OverBudget(ChunkStreamer *streamer, World *world, u32 extra_chunks)
+{
+    StreamConfig *config = &streamer->config;
+    u64 extra_bytes = extra_chunks * (sizeof(Chunk) + sizeof(ChunkData));
+
+    return world->chunk_count + extra_chunks > Min(config->max_resident_chunks, world->max_chunks) ||
+           world->data_count + extra_chunks > world->max_data ||
+           ResidentBytes(world) + extra_bytes > config->max_resident_bytes;
+}
+
+// Evicts the least recently used chunk outside the radius. Fails when every
+// resident chunk is in use or a save job can not be started.
+static bool EvictOldest(ChunkStreamer *streamer, World *world, PlatformApi *platform)
+{
+    Chunk *oldest = NULL;
+    for (u32 i = 0; i < world->chunk_count; ++i)
+    {
+        Chunk *chunk = world->chunks + i;
+        if (chunk->last_used == streamer->tick || (chunk->flags & (ChunkFlag_Loading | ChunkFlag_Pinned)))
+        {
+            continue;
+        }
+
+        if (!oldest || chunk->last_used < oldest->last_used)
+        {
+            oldest = chunk;
+        }
+    }
+
+    if (!oldest)
+    {
+        return false;
+    }
+
+    if (streamer->config.serialize && (oldest->flags & ChunkFlag_Modified))
+    {
+        // The save job owns the data until it is written
+        ChunkData *data = oldest->data;
+        StreamJob *job = NULL;
+        if (data)
+        {
+            job = BeginJob(streamer, platform, StreamJob_Save, oldest->x, oldest->y, data);
+            if (!job)
+            {
+                return false;
+            }
+            job->enemy_count = oldest->enemy_count;
+            job->tower_count = oldest->tower_count;
+            oldest->data = NULL;
+        }
+
+        // Empty chunks still need their (empty) save, otherwise the stale one would load back
+        else
+        {
+            ChunkData *empty = AllocateChunkData(world);
+            if (!empty)
+            {
+                return false;
+            }
+            job = BeginJob(streamer, platform, StreamJob_Save, oldest->x, oldest->y, empty);
+            if (!job)
+            {
+                ReleaseChunkData(world, empty);
+                return false;
+            }
+        }
+
+        platform->AddWork(platform->work_queue, DoStreamWork, job);
+    }
+
+    RemoveChunk(world, oldest->x, oldest->y);
+    return true;
+}
+
+static bool RequestChunk(ChunkStreamer *streamer, World *world, PlatformApi *platform, i32 chunk_x, i32 chunk_y)
+{
+    if (!HasFreeJob(streamer) || IsSaving(streamer, chunk_x, chunk_y))
+    {
+        return false;
+    }
+
+    ChunkData *data = AllocateChunkData(world);
+    if (!data)
+    {
+        return false;
+    }
+
+    StreamJob *job = BeginJob(streamer, platform, StreamJob_Load, chunk_x, chunk_y, data);
+    Chunk *chunk = GetOrCreateChunk(world, chunk_x, chunk_y);
+    chunk->flags = ChunkFlag_Loading;
+    chunk->last_used = streamer->tick;
+
+    platform->AddWork(platform->work_queue, DoStreamWork, job);
+    return true;
+}
+
+void UpdateStreaming(ChunkStreamer *streamer, World *world, PlatformApi *platform, i32 center_x, i32 center_y)
+{
+    streamer->tick++;
+    FinishCompletedJobs(streamer, world);
+
+    // Touch everything in the radius before anything can be evicted
+    i32 radius = streamer->config.radius;
+    for (u32 i = 0; i < world->chunk_count; ++i)
+    {
+        Chunk *chunk = world->chunks + i;
+        if (Abs(chunk->x - center_x) <= radius && Abs(chunk->y - center_y) <= radius)
+        {
+            chunk->last_used = streamer->tick;
+        }
+    }
+
+    u32 evictions = 0;
+
+    // Nearest ring first, so the chunks around the center are requested before
+    // the job slots run out
+    for (i32 ring = 0; ring <= radius && HasFreeJob(streamer); ++ring)
+    {
+        for (i32 dy = -ring; dy <= ring; ++dy)
+        {
+            i32 step = (dy == -ring || dy == ring) ? 1 : 2 * ring;
+            for (i32 dx = -ring; dx <= ring; dx += step)
+            {
+                i32 chunk_x = center_x + dx;
+                i32 chunk_y = center_y + dy;
+
+                if (GetChunk(world, chunk_x, chunk_y) || !HasFreeJob(streamer))
+                {
+                    continue;
+                }
+
+                while (OverBudget(streamer, world, 1) && evictions < MAX_EVICTIONS_PER_TICK &&
+                       EvictOldest(streamer, world, platform))
+                {
+                    evictions++;
+                }
+
+                if (!OverBudget(streamer, world, 1))
+                {
+                    RequestChunk(streamer, world, platform, chunk_x, chunk_y);
+                }
+            }
+        }
+    }
+
+    // The budget may have shrunk
+    while (OverBudget(streamer, world, 0) && evictions < MAX_EVICTIONS_PER_TICK &&
+           EvictOldest(streamer, world, platform))
+    {
+        evictions++;
+    }
+}
+
+void FlushStreaming(ChunkStreamer *streamer, World *world, PlatformApi *platform)
+{
+    platform->CompleteAllWork(platform->work_queue);
+    FinishCompletedJobs(streamer, world);
+
+    if (!streamer->config.serialize)
+    {
+        return;
+    }
+
+    // Resident chunks are about to be cleared or the game is exiting, so their
+    // changes would be lost. Pinned chunks come from the level, not the save.
+    for (u32 i = 0; i < world->chunk_count; ++i)
+    {
+        Chunk *chunk = world->chunks + i;
+        if ((chunk->flags & ChunkFlag_Modified) && !(chunk->flags & ChunkFlag_Pinned))
+        {
+            SaveChunk(platform, chunk->x, chunk->y, chunk->enemy_count, chunk->tower_count, chunk->data);
+            chunk->flags &= ~ChunkFlag_Modified;
+        }
+    }
+}
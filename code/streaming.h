@@ -0,0 +1,63 @@
+#pragma once
+
+#include "defines.h"
+#include "platform.h"
+#include "world.h"
+
+// Keeps the chunks within `radius` of a center chunk resident. Missing chunks are
+// loaded from disk or generated on the platform work queue straight into pooled
+// ChunkData; chunks outside the radius are evicted least recently used first once
+// the resident set goes over budget. Only the main thread touches the World, the
+// workers only see their job.
+
+#define MAX_STREAM_JOBS 32
+// Bounds the main thread work per tick, so crossing into a new chunk row never spikes
+#define MAX_EVICTIONS_PER_TICK 16
+
+struct StreamConfig
+{
+    i32 radius;
+    u32 max_resident_chunks;
+    u64 max_resident_bytes;
+
+    // Save modified chunks on eviction and prefer saved chunks over generating
+    bool serialize;
+};
+
+enum StreamJobType
+{
+    StreamJob_Load,
+    StreamJob_Save,
+};
+
+struct StreamJob
+{
+    // Main thread only
+    bool in_use;
+    StreamJobType type;
+
+    i32 chunk_x;
+    i32 chunk_y;
+    ChunkData *data;
+    PlatformApi *platform;
+    bool serialize;
+
+    // Written by the worker before done is set
+    u32 enemy_count;
+    u32 tower_count;
+    volatile u32 done;
+};
+
+struct ChunkStreamer
+{
+    StreamConfig config;
+    u32 tick;
+
+    StreamJob jobs[MAX_STREAM_JOBS];
+};
+
+void InitializeStreamer(ChunkStreamer *streamer, StreamConfig config);
+void UpdateStreaming(ChunkStreamer *streamer, World *world, PlatformApi *platform, i32 center_x, i32 center_y);
+// Blocks until every job finished and applies the results, then saves the
+// modified resident chunks
+void FlushStreaming(ChunkStreamer *streamer, World *world, PlatformApi *platform);
@@ -0,0 +1,69 @@
+#include "transform.h"
+
+#include <assert.h>
+#include <string.h>
+
+TransformHierarchy PushTransformHierarchy(Arena *arena, u32 capacity)
+{
+    TransformHierarchy hierarchy = {};
+    hierarchy.capacity = capacity;
+    hierarchy.parents = PushArray(arena, u32, capacity);
+    hierarchy.translations = PushArray(arena, V3, capacity);
+    hierarchy.rotations = PushArray(arena, Quat, capacity);
+    hierarchy.scales = PushArray(arena, V3, capacity);
+    hierarchy.world = PushArray(arena, Mat4, capacity);
+    hierarchy.dirty = PushArrayZero(arena, u8, capacity);
+    return hierarchy;
+}
+
+u32 AddTransform(TransformHierarchy *hierarchy, u32 parent, V3 translation, Quat rotation, V3 scale)
+{
+    assert(hierarchy->count < hierarchy->capacity);
+    assert(parent == NO_PARENT || parent < hierarchy->count);
+
+    u32 node = hierarchy->count++;
+    hierarchy->parents[node] = parent;
+    SetTransform(hierarchy, node, translation, rotation, scale);
+    return node;
+}
+
+void SetTransform(TransformHierarchy *hierarchy, u32 node, V3 translation, Quat rotation, V3 scale)
+{
+    hierarchy->translations[node] = translation;
+    hierarchy->rotations[node] = rotation;
+    hierarchy->scales[node] = scale;
+    hierarchy->dirty[node] = 1;
+}
+
+void SetRotation(TransformHierarchy *hierarchy, u32 node, Quat rotation)
+{
+    hierarchy->rotations[node] = rotation;
+    hierarchy->dirty[node] = 1;
+}
+
+void UpdateWorldTransforms(TransformHierarchy *hierarchy)
+{
+    u32 *parents = hierarchy->parents;
+    u8 *dirty = hierarchy->dirty;
+
+    for (u32 i = 0; i < hierarchy->count; ++i)
+    {
+        u32 parent = parents[i];
+
+        // Parents are updated first, so their dirty flag already covers the whole chain above
+        if (parent != NO_PARENT)
+        {
+            dirty[i] |= dirty[parent];
+        }
+
+        if (!dirty[i])
+        {
+            continue;
+        }
+
+        Mat4 local = TRS(hierarchy->translations[i], hierarchy->rotations[i], hierarchy->scales[i]);
+        hierarchy->world[i] = parent == NO_PARENT ? local : hierarchy->world[parent] * local;
+    }
+
+    memset(dirty, 0, hierarchy->count);
+}
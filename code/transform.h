@@ -0,0 +1,34 @@
+#pragma once
+
+#include "defines.h"
+#include "game_math.h"
+#include "memory.h"
+
+// Flat transform hierarchy. Nodes are stored in topological order (a parent
+// always has a lower index than its children), so one linear pass updates every
+// world matrix. Only dirty nodes and their descendants are recomputed.
+
+#define NO_PARENT 0xffffffff
+
+struct TransformHierarchy
+{
+    u32 count;
+    u32 capacity;
+
+    u32 *parents;
+    V3 *translations;
+    Quat *rotations;
+    V3 *scales;
+
+    Mat4 *world;
+    u8 *dirty;
+};
+
+TransformHierarchy PushTransformHierarchy(Arena *arena, u32 capacity);
+
+// parent must already be in the hierarchy (or NO_PARENT)
+u32 AddTransform(TransformHierarchy *hierarchy, u32 parent, V3 translation, Quat rotation, V3 scale);
+void SetTransform(TransformHierarchy *hierarchy, u32 node, V3 translation, Quat rotation, V3 scale);
+void SetRotation(TransformHierarchy *hierarchy, u32 node, Quat rotation);
+
+void UpdateWorldTransforms(TransformHierarchy *hierarchy);
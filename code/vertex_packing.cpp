@@ -0,0 +1,178 @@
+#include "vertex_packing.h"
+
+#include <math.h>
+#include <string.h>
+
+// Round to nearest even, overflow to infinity, denormals kept
+u16 F32ToF16(f32 value)
+{
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    u32 sign = (bits >> 16) & 0x8000;
+    u32 exponent = (bits >> 23) & 0xff;
+    u32 mantissa = bits & 0x7fffff;
+
+    // Inf and NaN, keeping NaN a NaN
+    if (exponent == 0xff)
+    {
+        return (u16) (sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+
+    i32 half_exponent = (i32) exponent - 127 + 15;
+    if (half_exponent >= 31)
+    {
+        return (u16) (sign | 0x7c00);
+    }
+
+    if (half_exponent <= 0)
+    {
+        // Too small for a denormal, flush to zero
+        if (half_exponent < -10)
+        {
+            return (u16) sign;
+        }
+
+        mantissa |= 0x800000;
+        u32 shift = 14 - half_exponent;
+        u32 half_mantissa = mantissa >> shift;
+        u32 remainder = mantissa & ((1 << shift) - 1);
+        u32 halfway = 1 << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half_mantissa & 1)))
+        {
+            half_mantissa++;
+        }
+        return (u16) (sign | half_mantissa);
+    }
+
+    u32 half = sign | (half_exponent << 10) | (mantissa >> 13);
+    u32 remainder = mantissa & 0x1fff;
+    // A carry out of the mantissa correctly bumps the exponent
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+    {
+        half++;
+    }
+    return (u16) half;
+}
+
+f32 F16ToF32(u16 value)
+{
+    u32 sign = (value & 0x8000) << 16;
+    u32 exponent = (value >> 10) & 0x1f;
+    u32 mantissa = value & 0x3ff;
+
+    u32 bits;
+    if (exponent == 0x1f)
+    {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if (exponent == 0)
+    {
+        // Zero or denormal, mantissa * 2^-24
+        f32 result = ldexpf((f32) mantissa, -24);
+        return sign ? -result : result;
+    }
+    else
+    {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    f32 result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+inline f32 SignNotZero(f32 value)
+{
+    return value >= 0 ? 1.0f : -1.0f;
+}
+
+inline i16 PackSnorm16(f32 value)
+{
+    return (i16) roundf(Clamp(value, -1, 1) * 32767);
+}
+
+void EncodeOctahedral(V3 normal, i16 *out)
+{
+    // Project onto the octahedron, then fold the lower half over the diagonals
+    f32 l1 = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+    f32 x = normal.x / l1;
+    f32 y = normal.y / l1;
+
+    if (normal.z < 0)
+    {
+        f32 folded_x = (1 - fabsf(y)) * SignNotZero(x);
+        f32 folded_y = (1 - fabsf(x)) * SignNotZero(y);
+        x = folded_x;
+        y = folded_y;
+    }
+
+    out[0] = PackSnorm16(x);
+    out[1] = PackSnorm16(y);
+}
+
+V3 DecodeOctahedral(i16 *encoded)
+{
+    f32 x = Max(encoded[0] / 32767.0f, -1);
+    f32 y = Max(encoded[1] / 32767.0f, -1);
+
+    V3 normal = v3(x, y, 1 - fabsf(x) - fabsf(y));
+    f32 t = Max(-normal.z, 0);
+    normal.x += normal.x >= 0 ? -t : t;
+    normal.y += normal.y >= 0 ? -t : t;
+    return Norm(normal);
+}
+
+inline u16 PackUnorm16(f32 value)
+{
+    return (u16) roundf(Clamp(value, 0, 1) * 65535);
+}
+
+inline u8 PackUnorm8(f32 value)
+{
+    return (u8) roundf(Clamp(value, 0, 1) * 255);
+}
+
+PackingError PackVertices(Vertex *vertices, u32 vertex_count, V3 bounds_min, V3 bounds_max, PackedVertex *out)
+{
+    PackingError error = {};
+
+    V3 extent = bounds_max - bounds_min;
+    f32 extents[3] = { extent.x, extent.y, extent.z };
+
+    for (u32 i = 0; i < vertex_count; ++i)
+    {
+        Vertex *vertex = vertices + i;
+        PackedVertex *packed = out + i;
+
+        V3 offset = vertex->position - bounds_min;
+        f32 offsets[3] = { offset.x, offset.y, offset.z };
+        for (u32 axis = 0; axis < 3; ++axis)
+        {
+            // Flat axes are stored as 0 and decode to bounds_min
+            f32 t = extents[axis] > 0 ? offsets[axis] / extents[axis] : 0;
+            packed->position[axis] = PackUnorm16(t);
+
+            f32 decoded = packed->position[axis] / 65535.0f * extents[axis];
+            error.position = Max(error.position, fabsf(decoded - offsets[axis]));
+        }
+        packed->position[3] = 0;
+
+        V3 normal = Norm(vertex->normal);
+        EncodeOctahedral(normal, packed->normal);
+        f32 cos_angle = Clamp(Dot(normal, DecodeOctahedral(packed->normal)), -1, 1);
+        error.normal = Max(error.normal, acosf(cos_angle) * (180.0f / PI));
+
+        packed->uv[0] = F32ToF16(vertex->uv.x);
+        packed->uv[1] = F32ToF16(vertex->uv.y);
+        error.uv = Max(error.uv, fabsf(F16ToF32(packed->uv[0]) - vertex->uv.x));
+        error.uv = Max(error.uv, fabsf(F16ToF32(packed->uv[1]) - vertex->uv.y));
+
+        packed->color[0] = PackUnorm8(vertex->color.x);
+        packed->color[1] = PackUnorm8(vertex->color.y);
+        packed->color[2] = PackUnorm8(vertex->color.z);
+        packed->color[3] = 255;
+    }
+
+    return error;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "defines.h"
+#include "game_math.h"
+#include "platform.h"
+
+// Conversion of imported mesh vertices to PackedVertex. shader/world.vert does
+// the inverse of every encoding here.
+
+// Largest difference between the vertices and their packed versions
+struct PackingError
+{
+    // In object space units
+    f32 position;
+    // In degrees
+    f32 normal;
+    f32 uv;
+};
+
+u16 F32ToF16(f32 value);
+f32 F16ToF32(u16 value);
+
+// Unit normal to two snorm16 octahedral coordinates
+void EncodeOctahedral(V3 normal, i16 *out);
+V3 DecodeOctahedral(i16 *encoded);
+
+// Positions are stored relative to bounds_min/max, which must contain them
+PackingError PackVertices(Vertex *vertices, u32 vertex_count, V3 bounds_min, V3 bounds_max, PackedVertex *out);
@@ -12,6 +12,11 @@
 
 #include "memory.cpp"
 #include "game_math.cpp"
+#include "transform.cpp"
+#include "profiler.cpp"
+#include "culling.cpp"
+#include "radix_sort.cpp"
+#include "vertex_packing.cpp"
 #include "opengl_renderer.cpp"
 
 // #ifndef DEBUG
@@ -27,6 +32,7 @@ V2 prev_mouse_pos = {};
 bool mouse_pos_updated = false;
 
 GameAssets assets = {};
+Arena asset_arena = {};
 
 struct GameCode
 {
@@ -35,6 +41,7 @@ struct GameCode
     FILETIME last_dll_modification;
     GameUpdateCall *GameUpdate;
     GameInitializeCall *GameInitialize;
+    GameShutdownCall *GameShutdown;
 };
 
 // Keys ...
@@ -47,6 +54,7 @@ char key_mapping[] = {
     'D',
     'C',
     'R',
+    'T',
 };
 
 bool prev_key_states[Key_Count] = {};
@@ -76,6 +84,192 @@ FileRead ReadFile(const char *filename, Arena *arena)
     return read;
 }
 
+bool Win32ReadFileInto(const char *filename, void *memory, u64 size)
+{
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER file_size = {};
+    DWORD bytes_read = 0;
+    bool result = GetFileSizeEx(file, &file_size) &&
+                  (u64) file_size.QuadPart == size &&
+                  ReadFile(file, memory, (DWORD) size, &bytes_read, NULL) &&
+                  bytes_read == size;
+
+    CloseHandle(file);
+    return result;
+}
+
+bool Win32WriteFile(const char *filename, void *memory, u64 size)
+{
+    HANDLE file = CreateFileA(filename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    DWORD bytes_written = 0;
+    bool result = WriteFile(file, memory, (DWORD) size, &bytes_written, NULL) && bytes_written == size;
+
+    CloseHandle(file);
+    return result;
+}
+
+MappedFile Win32MapFile(const char *filename)
+{
+    MappedFile result = {};
+
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return result;
+    }
+
+    // Empty files can not be mapped
+    LARGE_INTEGER file_size = {};
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+    {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping)
+        {
+            // The view keeps the mapping alive
+            result.memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            result.size = result.memory ? file_size.QuadPart : 0;
+            CloseHandle(mapping);
+        }
+    }
+
+    CloseHandle(file);
+    return result;
+}
+
+void Win32UnmapFile(MappedFile *file)
+{
+    if (file->memory)
+    {
+        UnmapViewOfFile(file->memory);
+    }
+    *file = {};
+}
+
+u64 Win32GetFileWriteTime(const char *filename)
+{
+    WIN32_FIND_DATA file_data = {};
+    HANDLE find = FindFirstFile(filename, &file_data);
+    if (find == INVALID_HANDLE_VALUE)
+    {
+        return 0;
+    }
+    FindClose(find);
+
+    FILETIME time = file_data.ftLastWriteTime;
+    return ((u64) time.dwHighDateTime << 32) | time.dwLowDateTime;
+}
+
+// Work queue...
+//
+
+struct WorkEntry
+{
+    WorkCallback *callback;
+    void *data;
+};
+
+// Single producer (the main thread), many consumers
+struct WorkQueue
+{
+    volatile u32 completion_goal;
+    volatile u32 completion_count;
+
+    volatile u32 next_entry_to_write;
+    volatile u32 next_entry_to_read;
+    HANDLE semaphore;
+
+    WorkEntry entries[256];
+};
+
+WorkQueue work_queue = {};
+
+void Win32AddWork(WorkQueue *queue, WorkCallback *callback, void *data)
+{
+    u32 next_entry_to_write = (queue->next_entry_to_write + 1) % lengthof(queue->entries);
+    assert(next_entry_to_write != queue->next_entry_to_read);
+
+    WorkEntry *entry = queue->entries + queue->next_entry_to_write;
+    entry->callback = callback;
+    entry->data = data;
+    queue->completion_goal++;
+
+    CompletePreviousWrites();
+    queue->next_entry_to_write = next_entry_to_write;
+    ReleaseSemaphore(queue->semaphore, 1, NULL);
+}
+
+// Returns true when there was nothing to do
+bool DoNextWorkEntry(WorkQueue *queue)
+{
+    u32 original_next_entry_to_read = queue->next_entry_to_read;
+    if (original_next_entry_to_read == queue->next_entry_to_write)
+    {
+        return true;
+    }
+
+    u32 next_entry_to_read = (original_next_entry_to_read + 1) % lengthof(queue->entries);
+    u32 index = InterlockedCompareExchange((volatile LONG *) &queue->next_entry_to_read,
+                                           next_entry_to_read, original_next_entry_to_read);
+    if (index == original_next_entry_to_read)
+    {
+        WorkEntry entry = queue->entries[index];
+        entry.callback(entry.data);
+        InterlockedIncrement((volatile LONG *) &queue->completion_count);
+    }
+
+    return false;
+}
+
+void Win32CompleteAllWork(WorkQueue *queue)
+{
+    while (queue->completion_goal != queue->completion_count)
+    {
+        DoNextWorkEntry(queue);
+    }
+
+    queue->completion_goal = 0;
+    queue->completion_count = 0;
+}
+
+DWORD WINAPI WorkerThread(LPVOID parameter)
+{
+    WorkQueue *queue = (WorkQueue *) parameter;
+    for (;;)
+    {
+        if (DoNextWorkEntry(queue))
+        {
+            WaitForSingleObjectEx(queue->semaphore, INFINITE, FALSE);
+        }
+    }
+}
+
+void InitializeWorkQueue(WorkQueue *queue)
+{
+    SYSTEM_INFO system_info = {};
+    GetSystemInfo(&system_info);
+
+    // Leave a core for the main thread
+    u32 thread_count = system_info.dwNumberOfProcessors > 1 ? system_info.dwNumberOfProcessors - 1 : 1;
+    thread_count = thread_count > 8 ? 8 : thread_count;
+
+    queue->semaphore = CreateSemaphoreEx(NULL, 0, thread_count, NULL, 0, SEMAPHORE_ALL_ACCESS);
+    for (u32 i = 0; i < thread_count; ++i)
+    {
+        HANDLE thread = CreateThread(NULL, 0, WorkerThread, queue, 0, NULL);
+        CloseHandle(thread);
+    }
+}
+
 // Window / Opengl stuff...
 //
 
@@ -160,8 +354,15 @@ inline V3 ufbx_to_v3(ufbx_vec3 vec)
     return { (f32) vec.x, (f32) vec.y, (f32) vec.z };
 }
 
+inline Quat ufbx_to_quat(ufbx_quat q)
+{
+    return { (f32) q.x, (f32) q.y, (f32) q.z, (f32) q.w };
+}
+
 Mesh LoadFBXMesh(ufbx_mesh *mesh)
 {
+    TimeFunction;
+
     TempMemory temp_region = ScratchAllocate();
 
     // TODO: mesh->material_parts contains the mesh split by material. Maybe use that?
@@ -184,7 +385,7 @@ Mesh LoadFBXMesh(ufbx_mesh *mesh)
 
             Vertex *v = vertices + num_vertices;
             v->position = ufbx_to_v3(ufbx_get_vertex_vec3(&mesh->vertex_position, index));
-            v->normal = ufbx_to_v3(ufbx_get_vertex_vec3(&mesh->vertex_normal, index));
+            v->normal = mesh->vertex_normal.exists ? ufbx_to_v3(ufbx_get_vertex_vec3(&mesh->vertex_normal, index)) : v3(0, 0, 1);
             v->uv = ufbx_to_v2(ufbx_get_vertex_vec2(&mesh->vertex_uv, index));
             v->color = v3(1);
 
@@ -194,6 +395,15 @@ Mesh LoadFBXMesh(ufbx_mesh *mesh)
 
     assert(num_vertices == num_triangles * 3);
 
+    V3 bounds_min = v3(INFINITY);
+    V3 bounds_max = v3(-INFINITY);
+    for (u32 i = 0; i < num_vertices; ++i)
+    {
+        V3 p = vertices[i].position;
+        bounds_min = v3(Min(bounds_min.x, p.x), Min(bounds_min.y, p.y), Min(bounds_min.z, p.z));
+        bounds_max = v3(Max(bounds_max.x, p.x), Max(bounds_max.y, p.y), Max(bounds_max.z, p.z));
+    }
+
     ufbx_vertex_stream streams[1] = {
         { vertices, num_vertices, sizeof(Vertex) },
     };
@@ -202,7 +412,17 @@ Mesh LoadFBXMesh(ufbx_mesh *mesh)
 
     num_vertices = ufbx_generate_indices(streams, 1, indices, num_indices, NULL, NULL);
 
-    Mesh result = CreateMesh(vertices, num_vertices, indices, num_indices);
+    PackedVertex *packed = PushArray(temp_region.arena, PackedVertex, num_vertices);
+    PackingError error = PackVertices(vertices, num_vertices, bounds_min, bounds_max, packed);
+    printf("Packed mesh %s: %u vertices, %llu -> %llu bytes, max error position %f, normal %f deg, uv %f\n",
+           mesh->name.data, num_vertices,
+           (unsigned long long) sizeof(Vertex) * num_vertices, (unsigned long long) sizeof(PackedVertex) * num_vertices,
+           error.position, error.normal, error.uv);
+
+    Mesh result = CreateMesh(packed, num_vertices, indices, num_indices);
+    result.bounds_min = bounds_min;
+    result.bounds_max = bounds_max;
+    result.has_normals = mesh->vertex_normal.exists;
 
     EndTempRegion(temp_region);
 
@@ -233,7 +453,46 @@ void LoadAllFBXMeshes()
     //     some_mesh = LoadFBXMesh(mesh);
     // }
 
-    assets.alien = LoadFBXMesh(scene->meshes.data[0]);
+    TempMemory temp_region = ScratchAllocate();
+
+    // Add the nodes level by level so parents always precede their children
+    u32 node_count = scene->nodes.count;
+    u32 *node_to_transform = PushArray(temp_region.arena, u32, node_count);
+    assets.scene = PushTransformHierarchy(&asset_arena, node_count);
+
+    u32 max_depth = 0;
+    for (u32 i = 0; i < node_count; ++i)
+    {
+        max_depth = scene->nodes.data[i]->node_depth > max_depth ? scene->nodes.data[i]->node_depth : max_depth;
+    }
+
+    for (u32 depth = 0; depth <= max_depth; ++depth)
+    {
+        for (u32 i = 0; i < node_count; ++i)
+        {
+            ufbx_node *node = scene->nodes.data[i];
+            if (node->node_depth != depth)
+            {
+                continue;
+            }
+
+            u32 parent = node->parent ? node_to_transform[node->parent->typed_id] : NO_PARENT;
+            ufbx_transform transform = node->local_transform;
+            node_to_transform[node->typed_id] = AddTransform(&assets.scene, parent,
+                                                             ufbx_to_v3(transform.translation),
+                                                             ufbx_to_quat(transform.rotation),
+                                                             ufbx_to_v3(transform.scale));
+        }
+    }
+
+    UpdateWorldTransforms(&assets.scene);
+
+    ufbx_mesh *alien_mesh = scene->meshes.data[0];
+    assets.alien = LoadFBXMesh(alien_mesh);
+    assert(alien_mesh->instances.count > 0);
+    assets.alien_node = node_to_transform[alien_mesh->instances.data[0]->typed_id];
+
+    EndTempRegion(temp_region);
 
     ufbx_free_scene(scene);
 }
@@ -268,7 +527,8 @@ GameCode LoadGameCode()
         result.last_dll_modification = GetDLLWriteTime();
         result.GameUpdate = (GameUpdateCall *) GetProcAddress(result.game_code_dll, "GameUpdate");
         result.GameInitialize = (GameInitializeCall *) GetProcAddress(result.game_code_dll, "GameInitialize");
-        result.valid = result.GameUpdate && result.GameInitialize;
+        result.GameShutdown = (GameShutdownCall *) GetProcAddress(result.game_code_dll, "GameShutdown");
+        result.valid = result.GameUpdate && result.GameInitialize && result.GameShutdown;
     }
 
     // TODO: Set fallback procs here
@@ -292,6 +552,8 @@ i32 main()
     scratch.capacity = MegaByte(1);
     scratch.memory = (u8*) malloc(scratch.capacity);
 
+    InitializeProfiler();
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
@@ -325,7 +587,24 @@ i32 main()
     glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
 #endif
 
-    InitializeRenderer();
+    InitializeWorkQueue(&work_queue);
+    CreateDirectoryA("save", NULL);
+    CreateDirectoryA("shader_cache", NULL);
+
+    PlatformApi platform = {};
+    platform.work_queue = &work_queue;
+    platform.AddWork = Win32AddWork;
+    platform.CompleteAllWork = Win32CompleteAllWork;
+    platform.ReadFileInto = Win32ReadFileInto;
+    platform.WriteFile = Win32WriteFile;
+    platform.MapFile = Win32MapFile;
+    platform.UnmapFile = Win32UnmapFile;
+    platform.GetFileWriteTime = Win32GetFileWriteTime;
+
+    asset_arena.capacity = MegaByte(1);
+    asset_arena.memory = (u8 *) malloc(asset_arena.capacity);
+
+    InitializeRenderer(&platform);
     LoadAllFBXMeshes();
 
     u64 game_memory_size = MegaByte(10);
@@ -333,9 +612,10 @@ i32 main()
 
     GameCode game_code = LoadGameCode();
 
-    game_code.GameInitialize(game_memory, game_memory_size);
+    game_code.GameInitialize(&platform, game_memory, game_memory_size);
 
     f32 prev_time = glfwGetTime();
+    f32 last_profile_time = prev_time;
     u32 prev_key_states = 0;
 
     while (!glfwWindowShouldClose(window))
@@ -347,10 +627,14 @@ i32 main()
         FILETIME dll_write_time = GetDLLWriteTime();
         if (CompareFileTime(&game_code.last_dll_modification, &dll_write_time) == -1)
         {
+            // Queued work points into the old dll
+            Win32CompleteAllWork(&work_queue);
             UnloadGameCode(&game_code);
             game_code = LoadGameCode();
         }
 
+        ReloadShaders();
+
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         {
             glfwSetWindowShouldClose(window, true);
@@ -381,13 +665,37 @@ i32 main()
         }
         prev_key_states = input.key_states;
 
-        RenderData *render_data = game_code.GameUpdate(&input, &assets, game_memory);
+        platform.frame_quads = BeginFrame(&platform.frame_quad_capacity);
+
+        RenderData *render_data;
+        {
+            TimeBlock("GameUpdate");
+            render_data = game_code.GameUpdate(&input, &assets, &platform, game_memory);
+        }
 
         DrawFrame(render_data, window_width, window_height);
 
+#ifdef PROFILE
+        if (time - last_profile_time > 5)
+        {
+            PrintProfile();
+            ResetProfile();
+            last_profile_time = time;
+        }
+#endif
+
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    // Saves what is still resident and lets pending chunk saves finish
+    game_code.GameShutdown(&platform, game_memory);
+    Win32CompleteAllWork(&work_queue);
+
     glfwTerminate();
+
+#ifdef PROFILE
+    PrintProfile();
+#endif
+    ShutdownProfiler();
 }
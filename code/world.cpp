@@ -0,0 +1,186 @@
+#include "world.h"
+
+#include <assert.h>
+
+#define EMPTY_SLOT 0xffffffff
+
+inline u64 ChunkKey(i32 chunk_x, i32 chunk_y)
+{
+    return ((u64) (u32) chunk_x << 32) | (u32) chunk_y;
+}
+
+inline u32 ChunkSlot(World *world, u64 key)
+{
+    // Fibonacci hashing, the high bits are the well mixed ones
+    u32 shift = 64 - CountTrailingZeros(world->slot_count);
+    return (u32) ((key * 0x9E3779B97F4A7C15ull) >> shift);
+}
+
+void InitializeWorld(World *world, Arena *arena, u32 max_chunks, u32 max_data)
+{
+    assert(max_chunks > 0);
+    *world = {};
+
+    u32 slot_count = 1;
+    while (slot_count < max_chunks * 2)
+    {
+        slot_count <<= 1;
+    }
+
+    world->slot_count = slot_count;
+    world->slot_keys = PushArray(arena, u64, slot_count);
+    world->slot_chunks = PushArray(arena, u32, slot_count);
+
+    world->max_chunks = max_chunks;
+    world->chunks = PushArray(arena, Chunk, max_chunks);
+
+    world->max_data = max_data;
+    ChunkData *data = PushArray(arena, ChunkData, max_data);
+    for (u32 i = 0; i < max_data; ++i)
+    {
+        data[i].next_free = i + 1 < max_data ? data + i + 1 : NULL;
+    }
+    world->free_data = data;
+
+    ClearWorld(world);
+}
+
+void ClearWorld(World *world)
+{
+    for (u32 i = 0; i < world->slot_count; ++i)
+    {
+        world->slot_chunks[i] = EMPTY_SLOT;
+    }
+
+    for (u32 i = 0; i < world->chunk_count; ++i)
+    {
+        if (world->chunks[i].data)
+        {
+            ReleaseChunkData(world, world->chunks[i].data);
+        }
+    }
+
+    world->chunk_count = 0;
+}
+
+bool SetTile(World *world, i32 tile_x, i32 tile_y, TileType tile)
+{
+    Chunk *chunk = GetChunk(world, ChunkCoordinate(tile_x), ChunkCoordinate(tile_y));
+    if (!chunk || !(chunk->flags & ChunkFlag_HasTiles))
+    {
+        return false;
+    }
+
+    chunk->data->tiles[TileIndex(tile_x, tile_y)] = tile;
+    chunk->flags |= ChunkFlag_Modified;
+    TouchTiles(world, chunk);
+    return true;
+}
+
+ChunkData *AllocateChunkData(World *world)
+{
+    ChunkData *data = world->free_data;
+    if (data)
+    {
+        world->free_data = data->next_free;
+        world->data_count++;
+    }
+    return data;
+}
+
+void ReleaseChunkData(World *world, ChunkData *data)
+{
+    assert(world->data_count > 0);
+    data->next_free = world->free_data;
+    world->free_data = data;
+    world->data_count--;
+}
+
+// Returns the slot holding key, or the empty slot where it would go
+static u32 FindSlot(World *world, u64 key)
+{
+    u32 mask = world->slot_count - 1;
+    u32 slot = ChunkSlot(world, key);
+
+    while (world->slot_chunks[slot] != EMPTY_SLOT && world->slot_keys[slot] != key)
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+Chunk *GetChunk(World *world, i32 chunk_x, i32 chunk_y)
+{
+    u32 slot = FindSlot(world, ChunkKey(chunk_x, chunk_y));
+    u32 index = world->slot_chunks[slot];
+    return index == EMPTY_SLOT ? NULL : world->chunks + index;
+}
+
+Chunk *GetOrCreateChunk(World *world, i32 chunk_x, i32 chunk_y)
+{
+    u64 key = ChunkKey(chunk_x, chunk_y);
+    u32 slot = FindSlot(world, key);
+
+    if (world->slot_chunks[slot] != EMPTY_SLOT)
+    {
+        return world->chunks + world->slot_chunks[slot];
+    }
+
+    assert(world->chunk_count < world->max_chunks);
+
+    u32 index = world->chunk_count++;
+    world->slot_keys[slot] = key;
+    world->slot_chunks[slot] = index;
+
+    Chunk *chunk = world->chunks + index;
+    *chunk = {};
+    chunk->x = chunk_x;
+    chunk->y = chunk_y;
+
+    return chunk;
+}
+
+void RemoveChunk(World *world, i32 chunk_x, i32 chunk_y)
+{
+    u32 mask = world->slot_count - 1;
+    u32 slot = FindSlot(world, ChunkKey(chunk_x, chunk_y));
+    u32 index = world->slot_chunks[slot];
+
+    if (index == EMPTY_SLOT)
+    {
+        return;
+    }
+
+    Chunk *chunk = world->chunks + index;
+    if (chunk->data)
+    {
+        ReleaseChunkData(world, chunk->data);
+    }
+
+    // Backward shift deletion: pull later entries of the probe run into the hole
+    // so lookups never need tombstones.
+    u32 hole = slot;
+    u32 next = (hole + 1) & mask;
+    while (world->slot_chunks[next] != EMPTY_SLOT)
+    {
+        u32 home = ChunkSlot(world, world->slot_keys[next]);
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            world->slot_keys[hole] = world->slot_keys[next];
+            world->slot_chunks[hole] = world->slot_chunks[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    world->slot_chunks[hole] = EMPTY_SLOT;
+
+    // Keep the active list dense
+    u32 last = --world->chunk_count;
+    if (index != last)
+    {
+        Chunk *moved = world->chunks + last;
+        world->chunks[index] = *moved;
+        world->slot_chunks[FindSlot(world, ChunkKey(moved->x, moved->y))] = index;
+    }
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "defines.h"
+#include "game_math.h"
+#include "memory.h"
+#include "platform.h"
+
+// Sparse chunk storage. Only occupied chunks exist: a hash map keyed by the
+// chunk coordinate points into a dense array of small chunk headers (the
+// active list), and the entity payload of each chunk lives in a separate pool
+// that is only touched when the entities themselves are needed.
+
+#define CHUNK_ENEMY_CAPACITY 64
+#define CHUNK_TOWER_CAPACITY 64
+
+struct Tower
+{
+    i32 tile_x;
+    i32 tile_y;
+};
+
+enum TileType : u8
+{
+    Tile_Empty,
+    Tile_Wall,
+    Tile_Floor,
+    Tile_EnemySpawn,
+    Tile_PlayerSpawn,
+    Tile_Count,
+};
+
+// Per enemy flags are one u64 bitset per flag
+static_assert(CHUNK_ENEMY_CAPACITY == 64, "enemy bitsets are u64");
+
+enum EnemyState : u8
+{
+    EnemyState_Wander,
+    EnemyState_Attack,
+};
+
+// Pooled. Enemies are structure of arrays, dense in [0, enemy_count) and 32 byte
+// aligned, so the update kernels run over whole lanes. Padding lanes up to the
+// next multiple of BATCH_WIDTH hold garbage. Columns are ordered by how often
+// they are touched: the movement kernel never pulls in hp, state or towers.
+struct alignas(32) ChunkData
+{
+    // Hot
+    f32 enemy_x[CHUNK_ENEMY_CAPACITY];
+    f32 enemy_y[CHUNK_ENEMY_CAPACITY];
+    f32 enemy_vel_x[CHUNK_ENEMY_CAPACITY];
+    f32 enemy_vel_y[CHUNK_ENEMY_CAPACITY];
+
+    // Warm. Damage accumulates during the tick and is applied by the update kernel.
+    f32 enemy_hp[CHUNK_ENEMY_CAPACITY];
+    f32 enemy_damage[CHUNK_ENEMY_CAPACITY];
+    u64 enemy_hurt;
+
+    // Cold
+    EnemyState enemy_state[CHUNK_ENEMY_CAPACITY];
+    Tower towers[CHUNK_TOWER_CAPACITY];
+
+    // TileType, row major. Only meaningful with ChunkFlag_HasTiles.
+    u8 tiles[CHUNK_SIZE * CHUNK_SIZE];
+
+    ChunkData *next_free;
+};
+
+enum ChunkFlags
+{
+    ChunkFlag_Loading = 1 << 0,
+    // Changed since it was generated or loaded, so it has to be saved on eviction
+    ChunkFlag_Modified = 1 << 1,
+    // Never evicted, e.g. chunks of a loaded level
+    ChunkFlag_Pinned = 1 << 2,
+    ChunkFlag_HasTiles = 1 << 3,
+};
+
+// Hot, iterated every tick
+struct Chunk
+{
+    i32 x;
+    i32 y;
+    u32 flags;
+    u32 last_used;
+
+    u32 enemy_count;
+    u32 tower_count;
+    u32 tile_version;
+
+    // NULL for empty chunks
+    ChunkData *data;
+};
+
+struct World
+{
+    // Open addressing, linear probing. slot_count is a power of two and at least
+    // twice max_chunks, so probes stay short and there is always an empty slot.
+    u32 slot_count;
+    u64 *slot_keys;
+    u32 *slot_chunks;
+
+    u32 chunk_count;
+    u32 max_chunks;
+    Chunk *chunks;
+
+    u32 data_count;
+    u32 max_data;
+    ChunkData *free_data;
+
+    // Never reset, so a tile_version is never reused by a different set of tiles
+    u32 tile_version;
+};
+
+// max_chunks bounds the resident chunks, max_data the ones with entities in them
+void InitializeWorld(World *world, Arena *arena, u32 max_chunks, u32 max_data);
+void ClearWorld(World *world);
+
+// NULL when the chunk is not resident
+Chunk *GetChunk(World *world, i32 chunk_x, i32 chunk_y);
+Chunk *GetOrCreateChunk(World *world, i32 chunk_x, i32 chunk_y);
+// Invalidates Chunk pointers, the last chunk is moved into the removed one's place.
+// Releases the chunk's data, detach it first to keep it.
+void RemoveChunk(World *world, i32 chunk_x, i32 chunk_y);
+
+// Marks the chunk's tiles as changed
+inline void TouchTiles(World *world, Chunk *chunk)
+{
+    chunk->tile_version = ++world->tile_version;
+}
+
+// Only for chunks with tiles, returns false otherwise
+bool SetTile(World *world, i32 tile_x, i32 tile_y, TileType tile);
+
+// NULL when the pool is exhausted
+ChunkData *AllocateChunkData(World *world);
+void ReleaseChunkData(World *world, ChunkData *data);
+
+inline u64 ResidentBytes(World *world)
+{
+    return world->chunk_count * sizeof(Chunk) + world->data_count * sizeof(ChunkData);
+}
+
+// Floor division, so negative tiles land in negative chunks
+inline i32 ChunkCoordinate(i32 tile)
+{
+    return (tile >= 0 ? tile : tile - CHUNK_SIZE + 1) / CHUNK_SIZE;
+}
+
+inline u32 TileIndex(i32 tile_x, i32 tile_y)
+{
+    return (tile_y - ChunkCoordinate(tile_y) * CHUNK_SIZE) * CHUNK_SIZE + tile_x - ChunkCoordinate(tile_x) * CHUNK_SIZE;
+}
@@ -0,0 +1,20 @@
+#version 440
+
+layout (binding = 0) uniform sampler2D level;
+
+in vec2 uv;
+
+out vec4 out_Color;
+
+void main()
+{
+    vec4 color = texture(level, uv);
+
+    // Uncovered parts of the cache are transparent, keep the background
+    if (color.a < 0.5)
+    {
+        discard;
+    }
+
+    out_Color = color;
+}
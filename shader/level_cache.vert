@@ -0,0 +1,24 @@
+#version 440
+
+layout (std140, binding = 1) uniform matrices
+{
+    mat4 projection;
+    mat4 view;
+};
+
+// xy: min corner, zw: max corner of the cached region in world space
+layout (location = 1) uniform vec4 rect;
+
+out vec2 uv;
+
+// Same corners as shader/quad.vert
+const vec2 corners[4] = vec2[](vec2(0, 0), vec2(1, 0), vec2(0, 1), vec2(1, 1));
+
+void main()
+{
+    vec2 corner = corners[gl_VertexID];
+    uv = corner;
+
+    vec2 position = mix(rect.xy, rect.zw, corner);
+    gl_Position = projection * view * vec4(position, 0, 1);
+}
@@ -0,0 +1,25 @@
+#version 440
+
+// One instance per quad
+layout (location = 0) in vec2 aTopleft;
+layout (location = 1) in vec2 aSize;
+layout (location = 2) in vec4 aColor;
+
+layout (std140, binding = 1) uniform matrices
+{
+    mat4 projection;
+    mat4 view;
+};
+
+out vec3 color;
+
+// Triangle strip corners: topleft, +x, +y, opposite
+const vec2 corners[4] = vec2[](vec2(0, 0), vec2(1, 0), vec2(0, 1), vec2(1, 1));
+
+void main()
+{
+    color = aColor.rgb;
+
+    vec2 position = aTopleft + corners[gl_VertexID] * aSize;
+    gl_Position = projection * view * vec4(position, 0, 1);
+}
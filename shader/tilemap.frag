@@ -0,0 +1,25 @@
+#version 440
+
+#define CHUNK_SIZE 16
+
+layout (binding = 0) uniform usampler2DArray tiles;
+layout (location = 1) uniform vec3 palette[16];
+
+in vec2 tile_coord;
+flat in int layer;
+
+out vec4 out_Color;
+
+void main()
+{
+    ivec2 tile = min(ivec2(tile_coord), ivec2(CHUNK_SIZE - 1));
+    uint type = texelFetch(tiles, ivec3(tile, layer), 0).r;
+
+    // Empty tiles let the background through, like the meshed path
+    if (type == 0)
+    {
+        discard;
+    }
+
+    out_Color = vec4(palette[type], 1);
+}
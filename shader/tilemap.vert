@@ -0,0 +1,32 @@
+#version 440
+
+layout (std140, binding = 1) uniform matrices
+{
+    mat4 projection;
+    mat4 view;
+};
+
+// CHUNK_SIZE tiles of TILE_SIZE pixels
+#define CHUNK_SIZE 16
+#define TILE_SIZE 32
+
+// x, y: chunk coordinate, z: texture layer
+layout (location = 17) uniform ivec4 chunks[64];
+
+out vec2 tile_coord;
+flat out int layer;
+
+// Same corners as shader/quad.vert
+const vec2 corners[4] = vec2[](vec2(0, 0), vec2(1, 0), vec2(0, 1), vec2(1, 1));
+
+void main()
+{
+    ivec4 chunk = chunks[gl_InstanceID];
+    vec2 corner = corners[gl_VertexID];
+
+    tile_coord = corner * CHUNK_SIZE;
+    layer = chunk.z;
+
+    vec2 position = (vec2(chunk.xy) + corner) * (CHUNK_SIZE * TILE_SIZE);
+    gl_Position = projection * view * vec4(position, 0, 1);
+}
@@ -0,0 +1,81 @@
+#version 460
+
+// Compiled once per set of feature defines, see ShaderFeature in opengl_renderer.cpp.
+// Without any it draws the level's float vertices with a model uniform.
+// QUANTIZED needs INSTANCED for the bounds, LIT needs QUANTIZED for the normals.
+
+#ifdef QUANTIZED
+// PackedVertex
+layout (location = 0) in vec4 aPosition;
+layout (location = 1) in vec2 aNormal;
+layout (location = 2) in vec2 aUv;
+layout (location = 3) in vec4 aColor;
+#else
+layout (location = 0) in vec3 aPosition;
+layout (location = 1) in vec3 aColor;
+#endif
+
+layout (std140, binding = 1) uniform matrices
+{
+    mat4 projection;
+    mat4 view;
+};
+
+#ifdef INSTANCED
+struct MeshInstance
+{
+    mat4 model;
+    // Positions are fractions of the mesh bounds
+    vec4 bounds_min;
+    vec4 bounds_extent;
+    uint tint;
+    uint draw;
+};
+
+// Written by shader/cull_instances.comp
+layout (std430, binding = 2) readonly buffer visible_instances
+{
+    MeshInstance instances[];
+};
+#else
+layout (location = 0) uniform mat4 model;
+#endif
+
+out vec3 color;
+
+#ifdef LIT
+// Inverse of EncodeOctahedral in vertex_packing.cpp
+vec3 DecodeOctahedral(vec2 encoded)
+{
+    vec3 normal = vec3(encoded, 1 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-normal.z, 0);
+    normal.xy += mix(vec2(t), vec2(-t), greaterThanEqual(normal.xy, vec2(0)));
+    return normalize(normal);
+}
+#endif
+
+void main()
+{
+#ifdef INSTANCED
+    // base_instance of the indirect draw points at the mesh's first visible instance
+    MeshInstance instance = instances[gl_BaseInstance + gl_InstanceID];
+    mat4 model = instance.model;
+    color = aColor.rgb * unpackUnorm4x8(instance.tint).rgb;
+#else
+    color = aColor.rgb;
+#endif
+
+#ifdef QUANTIZED
+    vec3 position = instance.bounds_min.xyz + aPosition.xyz * instance.bounds_extent.xyz;
+#else
+    vec3 position = aPosition.xyz;
+#endif
+
+#ifdef LIT
+    // Fixed light from above, so the shape reads without a lighting pass
+    vec3 normal = normalize(mat3(model) * DecodeOctahedral(aNormal));
+    color *= 0.4 + 0.6 * max(dot(normal, normalize(vec3(0.3, 0.5, 1))), 0);
+#endif
+
+    gl_Position = projection * view * model * vec4(position, 1);
+}